@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+# Generates a random, deterministic CAT program that can be run with lli once linked with runtime/cat_runtime.ll.
+# The program folds every value it reads into a checksum, which main prints before returning, so the output stays
+# small however much work the program does.
+
+import argparse
+import random
+import sys
+
+HEADER = '''declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_sub(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare void @CAT_destroy(i8*)
+declare void @cat_bench_touch(i8*)
+declare void @cat_bench_replace(i8**)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\\0A\\00"
+@checksum = global i64 0
+'''
+
+MAX_DEPTH = 3
+
+
+class FunctionBuilder:
+  def __init__(self, rng, name, objects, params, callees, globals):
+    self.rng = rng
+    self.name = name
+    self.params = params
+    self.callees = callees
+    self.globals = globals
+    self.body = []
+    self.block = "entry"
+    self.temps = 0
+    self.calls = 0
+    self.objects = list(params)
+    for _ in range(objects):
+      self.objects.append(self.emitValue("call i8* @CAT_new(i64 %d)" % rng.randint(0, 5)))
+    self.ptrs = []
+    for _ in range(2):
+      ptr = self.emitValue("alloca i8*")
+      self.emit("store i8* %s, i8** %s" % (rng.choice(self.objects), ptr))
+      self.ptrs.append(ptr)
+
+  def temp(self):
+    self.temps += 1
+    return "%%t%d" % self.temps
+
+  def fresh(self, prefix):
+    self.temps += 1
+    return "%s%d" % (prefix, self.temps)
+
+  def emit(self, line):
+    self.body.append("  " + line)
+
+  def emitValue(self, line):
+    value = self.temp()
+    self.emit("%s = %s" % (value, line))
+    return value
+
+  def label(self, name):
+    self.body.append(name + ":")
+    self.block = name
+
+  def object(self):
+    return self.rng.choice(self.objects)
+
+  def read(self, data):
+    value = self.emitValue("call i64 @CAT_get(i8* %s)" % data)
+    old = self.emitValue("load i64, i64* @checksum")
+    mixed = self.emitValue("mul i64 %s, 31" % old)
+    new = self.emitValue("add i64 %s, %s" % (mixed, value))
+    self.emit("store i64 %s, i64* @checksum" % new)
+
+  def op(self, depth):
+    rng = self.rng
+    kind = rng.randint(0, 13)
+    data = self.object()
+    if kind < 2:
+      self.emit("call void @CAT_set(i8* %s, i64 %d)" % (data, rng.randint(0, 3)))
+    elif kind < 4:
+      self.emit("call void @CAT_add(i8* %s, i8* %s, i8* %s)" % (data, self.object(), self.object()))
+    elif kind < 5:
+      self.emit("call void @CAT_sub(i8* %s, i8* %s, i8* %s)" % (data, self.object(), self.object()))
+    elif kind < 7:
+      self.read(data)
+    elif kind < 8:
+      self.emit("store i8* %s, i8** %s" % (data, rng.choice(self.ptrs)))
+    elif kind < 9:
+      loaded = self.emitValue("load i8*, i8** %s" % rng.choice(self.ptrs))
+      self.read(loaded)
+      if rng.random() < 0.5:
+        self.emit("call void @CAT_add(i8* %s, i8* %s, i8* %s)" % (loaded, data, loaded))
+    elif kind < 10 and self.globals:
+      # globals only ever hold the data main created for them, which no function receives as an argument
+      glob = "@g%d" % rng.randrange(self.globals)
+      if rng.random() < 0.3:
+        other = "@g%d" % rng.randrange(self.globals)
+        first = self.emitValue("load i8*, i8** %s" % glob)
+        second = self.emitValue("load i8*, i8** %s" % other)
+        self.emit("store i8* %s, i8** %s" % (second, glob))
+        self.emit("store i8* %s, i8** %s" % (first, other))
+      else:
+        loaded = self.emitValue("load i8*, i8** %s" % glob)
+        self.read(loaded)
+        if rng.random() < 0.5:
+          self.emit("call void @CAT_add(i8* %s, i8* %s, i8* %s)" % (loaded, loaded, data))
+    elif kind < 11:
+      # calls are kept out of loops and limited to one per function, so the work done at run time stays linear
+      chance = rng.random()
+      if chance < 0.3:
+        self.emit("call void @cat_bench_touch(i8* %s)" % data)
+      elif chance < 0.5:
+        self.emit("call void @cat_bench_replace(i8** %s)" % rng.choice(self.ptrs))
+      elif self.callees and depth == 0 and self.calls == 0:
+        self.calls += 1
+        self.emit("call void @%s(i64 %%arg, i8* %s)" % (rng.choice(self.callees), data))
+    elif kind < 12 and depth < MAX_DEPTH:
+      self.branch(depth)
+    elif depth < MAX_DEPTH:
+      self.loop(depth)
+
+  def branch(self, depth):
+    rng = self.rng
+    cond = self.emitValue("icmp sgt i64 %%arg, %d" % rng.randint(0, 3))
+    then, other, join = self.fresh("then"), self.fresh("else"), self.fresh("join")
+    self.emit("br i1 %s, label %%%s, label %%%s" % (cond, then, other))
+    ends = []
+    for name in (then, other):
+      self.label(name)
+      for _ in range(rng.randint(0, 3)):
+        self.op(depth + 1)
+      ends.append(self.block)
+      self.emit("br label %%%s" % join)
+    self.label(join)
+    phi = self.emitValue("phi i8* [ %s, %%%s ], [ %s, %%%s ]" % (self.object(), ends[0], self.object(), ends[1]))
+    select = self.emitValue("select i1 %s, i8* %s, i8* %s" % (cond, self.object(), phi))
+    self.read(phi)
+    self.read(select)
+    if rng.random() < 0.5:
+      self.emit("call void @CAT_add(i8* %s, i8* %s, i8* %s)" % (self.object(), select, phi))
+
+  def loop(self, depth):
+    rng = self.rng
+    preheader, header, exit = self.block, self.fresh("loop"), self.fresh("exit")
+    self.emit("br label %%%s" % header)
+    self.label(header)
+    iv = self.temp()
+    phiAt = len(self.body)
+    self.body.append(None)
+    for _ in range(rng.randint(1, 4)):
+      self.op(depth + 1)
+    step = self.emitValue("add i64 %s, 1" % iv)
+    cond = self.emitValue("icmp slt i64 %s, %d" % (step, rng.randint(2, 6)))
+    self.body[phiAt] = "  %s = phi i64 [ 0, %%%s ], [ %s, %%%s ]" % (iv, preheader, step, self.block)
+    self.emit("br i1 %s, label %%%s, label %%%s" % (cond, header, exit))
+    self.label(exit)
+
+  def build(self, size):
+    for _ in range(size):
+      self.op(0)
+    self.emit("ret void")
+    params = ", ".join(["i64 %arg"] + ["i8* " + param for param in self.params])
+    return "define void @%s(%s) {\nentry:\n%s\n}\n" % (self.name, params, "\n".join(self.body))
+
+
+def generate(seed, functions, size, globals):
+  rng = random.Random(seed)
+  out = [HEADER]
+  out += ["@g%d = global i8* null" % index for index in range(globals)]
+  out.append("")
+  names = []
+  for index in range(functions):
+    name = "f%d" % index
+    # each function may call one of the few functions generated right before it
+    out.append(FunctionBuilder(rng, name, rng.randint(1, 3), ["%p"], names[-3:], globals).build(size))
+    names.append(name)
+
+  main = ["define i32 @main(i32 %argc, i8** %argv) {", "entry:", "  %arg = sext i32 %argc to i64"]
+  for index in range(globals):
+    main.append("  %%init%d = call i8* @CAT_new(i64 %d)" % (index, index))
+    main.append("  store i8* %%init%d, i8** @g%d" % (index, index))
+  main.append("  %data = call i8* @CAT_new(i64 1)")
+  for name in names:
+    main.append("  call void @%s(i64 %%arg, i8* %%data)" % name)
+  main += [
+    "  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0",
+    "  %sum = load i64, i64* @checksum",
+    "  call i32 (i8*, ...) @printf(i8* %fmt, i64 %sum)",
+    "  ret i32 0",
+    "}",
+  ]
+  out.append("\n".join(main))
+  return "\n".join(out) + "\n"
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Generate a random CAT benchmark program.")
+  parser.add_argument("--seed", type=int, default=1)
+  parser.add_argument("--functions", type=int, default=40, help="number of functions besides main")
+  parser.add_argument("--size", type=int, default=100, help="number of top-level operations per function")
+  parser.add_argument("--globals", type=int, default=4, help="number of CAT globals")
+  parser.add_argument("-o", "--output", help="output file (default: stdout)")
+  args = parser.parse_args()
+
+  program = generate(args.seed, args.functions, args.size, args.globals)
+  if args.output:
+    with open(args.output, "w") as out:
+      out.write(program)
+  else:
+    sys.stdout.write(program)
+
+
+if __name__ == "__main__":
+  main()
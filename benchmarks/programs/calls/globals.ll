@@ -0,0 +1,110 @@
+; Many calls to small helpers that read and write CAT globals; some helpers leave their arguments untouched.
+
+declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_sub(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare void @CAT_destroy(i8*)
+declare void @cat_bench_touch(i8*)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+@g1 = global i8* null
+@g2 = global i8* null
+@g3 = global i8* null
+@g4 = global i8* null
+
+; only reads its argument
+define i64 @peek(i8* %d) {
+entry:
+  %v = call i64 @CAT_get(i8* %d)
+  ret i64 %v
+}
+
+; leaves its argument untouched
+define i64 @twice(i64 %x) {
+entry:
+  %y = add i64 %x, %x
+  ret i64 %y
+}
+
+; modifies its argument
+define void @bump(i8* %d) {
+entry:
+  call void @cat_bench_touch(i8* %d)
+  ret void
+}
+
+; writes through a global
+define void @reset_g2() {
+entry:
+  %d = load i8*, i8** @g2
+  call void @CAT_set(i8* %d, i64 9)
+  ret void
+}
+
+define void @accumulate_g1(i8* %src) {
+entry:
+  %d = load i8*, i8** @g1
+  call void @CAT_add(i8* %d, i8* %d, i8* %src)
+  ret void
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %a = call i8* @CAT_new(i64 1)
+  %b = call i8* @CAT_new(i64 2)
+  %c = call i8* @CAT_new(i64 3)
+  %d = call i8* @CAT_new(i64 4)
+  store i8* %a, i8** @g1
+  store i8* %b, i8** @g2
+  store i8* %c, i8** @g3
+  store i8* %d, i8** @g4
+  %n32 = mul i32 %argc, 2000
+  %n = sext i32 %n32 to i64
+  %local = call i8* @CAT_new(i64 5)
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %latch ]
+  %v1 = call i64 @peek(i8* %local)
+  %v2 = call i64 @twice(i64 %v1)
+  %l1 = call i64 @CAT_get(i8* %local)
+  call void @accumulate_g1(i8* %local)
+  call void @reset_g2()
+  %g2v = load i8*, i8** @g2
+  %v3 = call i64 @CAT_get(i8* %g2v)
+  %g3v = load i8*, i8** @g3
+  call void @CAT_add(i8* %g3v, i8* %g3v, i8* %g2v)
+  %rem = urem i64 %i, 7
+  %hit = icmp eq i64 %rem, 0
+  br i1 %hit, label %touch, label %latch
+
+touch:
+  %g4v = load i8*, i8** @g4
+  call void @bump(i8* %g4v)
+  br label %latch
+
+latch:
+  %next = add i64 %i, 1
+  %again = icmp slt i64 %next, %n
+  br i1 %again, label %loop, label %exit
+
+exit:
+  %r1 = call i64 @CAT_get(i8* %a)
+  %r3 = call i64 @CAT_get(i8* %c)
+  %r4 = call i64 @CAT_get(i8* %d)
+  %rl = call i64 @peek(i8* %local)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %r1)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %r3)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %r4)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %rl)
+  call void @CAT_destroy(i8* %a)
+  call void @CAT_destroy(i8* %b)
+  call void @CAT_destroy(i8* %c)
+  call void @CAT_destroy(i8* %d)
+  call void @CAT_destroy(i8* %local)
+  ret i32 0
+}
@@ -0,0 +1,63 @@
+; Loops that accumulate into CAT data, with loop-invariant constant work in their bodies.
+
+declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_sub(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare void @CAT_destroy(i8*)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %sum = call i8* @CAT_new(i64 0)
+  %one = call i8* @CAT_new(i64 1)
+  %step = call i8* @CAT_new(i64 0)
+  %tmp = call i8* @CAT_new(i64 0)
+  %n32 = mul i32 %argc, 5000
+  %n = sext i32 %n32 to i64
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ]
+  ; step is 2 at every iteration, tmp is recomputed from constants
+  call void @CAT_add(i8* %step, i8* %one, i8* %one)
+  call void @CAT_sub(i8* %tmp, i8* %step, i8* %one)
+  call void @CAT_add(i8* %sum, i8* %sum, i8* %step)
+  call void @CAT_add(i8* %sum, i8* %sum, i8* %tmp)
+  %next = add i64 %i, 1
+  %again = icmp slt i64 %next, %n
+  br i1 %again, label %loop, label %exit
+
+exit:
+  %vsum = call i64 @CAT_get(i8* %sum)
+  %vtmp = call i64 @CAT_get(i8* %tmp)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vsum)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vtmp)
+  br label %count
+
+count:
+  ; a counted loop with a constant trip count
+  %j = phi i64 [ 0, %exit ], [ %jnext, %count ]
+  call void @CAT_set(i8* %tmp, i64 5)
+  %vt = call i64 @CAT_get(i8* %tmp)
+  %even = and i64 %j, 1
+  %isEven = icmp eq i64 %even, 0
+  %pick = select i1 %isEven, i8* %one, i8* %tmp
+  call void @CAT_add(i8* %sum, i8* %sum, i8* %pick)
+  %jnext = add i64 %j, 1
+  %more = icmp slt i64 %jnext, 1000
+  br i1 %more, label %count, label %done
+
+done:
+  %vsum2 = call i64 @CAT_get(i8* %sum)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vsum2)
+  call void @CAT_destroy(i8* %sum)
+  call void @CAT_destroy(i8* %one)
+  call void @CAT_destroy(i8* %step)
+  call void @CAT_destroy(i8* %tmp)
+  ret i32 0
+}
@@ -0,0 +1,55 @@
+; Nested loops reading and writing CAT data, with CAT values flowing around the back edges.
+
+declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_sub(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare void @CAT_destroy(i8*)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %x = call i8* @CAT_new(i64 1)
+  %y = call i8* @CAT_new(i64 2)
+  %acc = call i8* @CAT_new(i64 0)
+  %n32 = mul i32 %argc, 100
+  %n = sext i32 %n32 to i64
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %inext, %outer.latch ]
+  ; the two values swap at each outer iteration
+  %cur = phi i8* [ %x, %entry ], [ %other, %outer.latch ]
+  %other = phi i8* [ %y, %entry ], [ %cur, %outer.latch ]
+  call void @CAT_set(i8* %x, i64 3)
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %jnext, %inner ]
+  call void @CAT_add(i8* %acc, i8* %acc, i8* %cur)
+  call void @CAT_sub(i8* %acc, i8* %acc, i8* %x)
+  call void @CAT_add(i8* %acc, i8* %acc, i8* %other)
+  %jnext = add i64 %j, 1
+  %inmore = icmp slt i64 %jnext, 50
+  br i1 %inmore, label %inner, label %outer.latch
+
+outer.latch:
+  %vx = call i64 @CAT_get(i8* %x)
+  %inext = add i64 %i, 1
+  %more = icmp slt i64 %inext, %n
+  br i1 %more, label %outer, label %exit
+
+exit:
+  %vacc = call i64 @CAT_get(i8* %acc)
+  %vy = call i64 @CAT_get(i8* %y)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vacc)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vy)
+  call void @CAT_destroy(i8* %x)
+  call void @CAT_destroy(i8* %y)
+  call void @CAT_destroy(i8* %acc)
+  ret i32 0
+}
@@ -0,0 +1,55 @@
+; CAT values merged by PHIs and selects, with the same or different constants on each path.
+
+declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_sub(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare void @CAT_destroy(i8*)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %a = call i8* @CAT_new(i64 3)
+  %b = call i8* @CAT_new(i64 3)
+  %c = call i8* @CAT_new(i64 6)
+  %r = call i8* @CAT_new(i64 0)
+  %many = icmp sgt i32 %argc, 2
+  br i1 %many, label %then, label %else
+
+then:
+  call void @CAT_set(i8* %a, i64 4)
+  call void @CAT_set(i8* %b, i64 10)
+  br label %join
+
+else:
+  call void @CAT_set(i8* %a, i64 4)
+  call void @CAT_add(i8* %b, i8* %b, i8* %c)
+  br label %join
+
+join:
+  ; a is 4 on both paths, b is 10 or 9
+  %p = phi i8* [ %a, %then ], [ %c, %else ]
+  %s = select i1 %many, i8* %a, i8* %b
+  call void @CAT_add(i8* %r, i8* %a, i8* %a)
+  %vr = call i64 @CAT_get(i8* %r)
+  %vb = call i64 @CAT_get(i8* %b)
+  %vp = call i64 @CAT_get(i8* %p)
+  %vs = call i64 @CAT_get(i8* %s)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vr)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vb)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vp)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vs)
+
+  call void @CAT_sub(i8* %r, i8* %p, i8* %s)
+  %vr2 = call i64 @CAT_get(i8* %r)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vr2)
+  call void @CAT_destroy(i8* %a)
+  call void @CAT_destroy(i8* %b)
+  call void @CAT_destroy(i8* %c)
+  call void @CAT_destroy(i8* %r)
+  ret i32 0
+}
@@ -0,0 +1,56 @@
+; Chains of constant CAT operations, folded and propagated to a fixed point.
+
+declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_sub(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare void @CAT_destroy(i8*)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %a = call i8* @CAT_new(i64 5)
+  %b = call i8* @CAT_new(i64 8)
+  %c = call i8* @CAT_new(i64 0)
+  %d = call i8* @CAT_new(i64 0)
+  call void @CAT_add(i8* %c, i8* %a, i8* %b)
+  call void @CAT_sub(i8* %d, i8* %c, i8* %a)
+  call void @CAT_add(i8* %a, i8* %c, i8* %d)
+  call void @CAT_sub(i8* %b, i8* %b, i8* %b)
+  %va = call i64 @CAT_get(i8* %a)
+  %vb = call i64 @CAT_get(i8* %b)
+  %vc = call i64 @CAT_get(i8* %c)
+  %vd = call i64 @CAT_get(i8* %d)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %va)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vb)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vc)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vd)
+
+  ; the value of argc is only known at run time
+  %n = sext i32 %argc to i64
+  %e = call i8* @CAT_new(i64 %n)
+  %f = call i8* @CAT_new(i64 0)
+  call void @CAT_add(i8* %f, i8* %e, i8* %d)
+  call void @CAT_sub(i8* %e, i8* %f, i8* %f)
+  %zero = call i8* @CAT_new(i64 0)
+  call void @CAT_add(i8* %d, i8* %f, i8* %zero)
+  %ve = call i64 @CAT_get(i8* %e)
+  %vf = call i64 @CAT_get(i8* %f)
+  %vd2 = call i64 @CAT_get(i8* %d)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %ve)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vf)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vd2)
+
+  call void @CAT_destroy(i8* %a)
+  call void @CAT_destroy(i8* %b)
+  call void @CAT_destroy(i8* %c)
+  call void @CAT_destroy(i8* %d)
+  call void @CAT_destroy(i8* %e)
+  call void @CAT_destroy(i8* %f)
+  call void @CAT_destroy(i8* %zero)
+  ret i32 0
+}
@@ -0,0 +1,45 @@
+; CAT values stored in stack slots and reached through pointers.
+
+declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_sub(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare void @CAT_destroy(i8*)
+declare i32 @printf(i8*, ...)
+declare void @cat_bench_touch(i8*)
+declare void @cat_bench_replace(i8**)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %slot1 = alloca i8*
+  %slot2 = alloca i8*
+  %a = call i8* @CAT_new(i64 2)
+  %b = call i8* @CAT_new(i64 7)
+  store i8* %a, i8** %slot1
+  store i8* %b, i8** %slot2
+  %l1 = load i8*, i8** %slot1
+  %l2 = load i8*, i8** %slot2
+  call void @CAT_add(i8* %l1, i8* %l1, i8* %l2)
+  %va = call i64 @CAT_get(i8* %a)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %va)
+
+  ; the opaque helper modifies b, and may replace the data in slot1
+  call void @cat_bench_touch(i8* %b)
+  %vb = call i64 @CAT_get(i8* %b)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %vb)
+  call void @cat_bench_replace(i8** %slot1)
+  %l3 = load i8*, i8** %slot1
+  %v3 = call i64 @CAT_get(i8* %l3)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %v3)
+  %va2 = call i64 @CAT_get(i8* %a)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %va2)
+
+  call void @CAT_destroy(i8* %a)
+  call void @CAT_destroy(i8* %b)
+  call void @CAT_destroy(i8* %l3)
+  ret i32 0
+}
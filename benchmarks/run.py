@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+# Runs the CAT pass over the benchmark corpus and reports, for every program, the time and peak memory of opt, and
+# how many CAT calls the program executes before and after the pass.
+# Results are written as JSON; a previous results file can be given with --baseline to compare against it.
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+RUNTIME = os.path.join(HERE, "runtime", "cat_runtime.ll")
+CALLS = re.compile(rb"^\[CAT\] calls executed: (\d+)$", re.M)
+
+# generated programs, as generate.py options
+GENERATED = {
+  "generated/large": ["--seed", "1", "--functions", "40", "--size", "100", "--globals", "4"],
+  "generated/calls": ["--seed", "2", "--functions", "200", "--size", "8", "--globals", "32"],
+}
+
+
+def fail(message):
+  sys.exit("run.py: " + message)
+
+
+def findLLVM(given):
+  if given:
+    return given
+  opt = shutil.which("opt")
+  if opt:
+    return os.path.dirname(opt)
+  try:
+    return subprocess.check_output(["llvm-config", "--bindir"], text=True).strip()
+  except (OSError, subprocess.CalledProcessError):
+    fail("cannot find opt, use --llvm-bin")
+
+
+def measure(command):
+  # returns the exit status, the wall time and the peak RSS in KB of command
+  start = time.perf_counter()
+  process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+  errors = process.stderr.read()
+  _, status, usage = os.wait4(process.pid, 0)
+  process.returncode = os.waitstatus_to_exitcode(status)
+  return process.returncode, time.perf_counter() - start, usage.ru_maxrss, errors
+
+
+def execute(tool, program, work, name):
+  # links program with the runtime and runs it, returns its output without the call count, the call count and the
+  # wall time
+  linked = os.path.join(work, name + ".linked.bc")
+  subprocess.run([tool("llvm-link"), program, RUNTIME, "-o", linked], check=True)
+  start = time.perf_counter()
+  result = subprocess.run([tool("lli"), linked], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+  seconds = time.perf_counter() - start
+  if result.returncode != 0:
+    return None, None, seconds
+  match = CALLS.search(result.stdout)
+  return CALLS.sub(b"", result.stdout), int(match.group(1)) if match else None, seconds
+
+
+def countInstructions(path):
+  with open(path) as source:
+    return sum(1 for line in source if line.startswith("  ") and not line.lstrip().startswith(";"))
+
+
+def corpus(work, filters):
+  programs = []
+  for root, _, files in os.walk(os.path.join(HERE, "programs")):
+    for file in sorted(files):
+      if file.endswith(".ll"):
+        path = os.path.join(root, file)
+        programs.append((os.path.relpath(path, os.path.join(HERE, "programs"))[:-3], path))
+  for name in GENERATED:
+    programs.append((name, os.path.join(work, name + ".ll")))
+  programs = [program for program in sorted(programs) if not filters or any(f in program[0] for f in filters)]
+
+  for name, path in programs:
+    if name in GENERATED:
+      os.makedirs(os.path.dirname(path), exist_ok=True)
+      subprocess.run([sys.executable, os.path.join(HERE, "generate.py"), "-o", path] + GENERATED[name], check=True)
+  return programs
+
+
+def benchmark(name, path, args, tool, work):
+  optimized = os.path.join(work, name + ".opt.bc")
+  os.makedirs(os.path.dirname(optimized), exist_ok=True)
+  load = ["-load", args.pass_path]
+  if args.new_pm:
+    command = [tool("opt")] + load + ["-load-pass-plugin=" + args.pass_path, "-passes=CAT"]
+  else:
+    command = [tool("opt"), "-enable-new-pm=0"] + load + ["-CAT"]
+  command += args.opt_args + [path, "-o", optimized]
+
+  result = {"instructions": countInstructions(path)}
+  times, peaks = [], []
+  for _ in range(args.repeat):
+    status, seconds, peak, errors = measure(command)
+    if status != 0:
+      sys.stderr.write(errors.decode(errors="replace"))
+      result["error"] = "opt exited with %d" % status
+      return result
+    times.append(seconds)
+    peaks.append(peak)
+  result["pass_seconds"] = min(times)
+  result["pass_peak_rss_kb"] = max(peaks)
+
+  before, callsBefore, _ = execute(tool, path, work, name + ".orig")
+  after, callsAfter, runSeconds = execute(tool, optimized, work, name + ".opt")
+  result["cat_calls_before"] = callsBefore
+  result["cat_calls_after"] = callsAfter
+  result["run_seconds"] = runSeconds
+  result["output_matches"] = before is not None and before == after
+  if not result["output_matches"]:
+    result["error"] = "the optimized program behaves differently"
+  return result
+
+
+def ratio(new, old):
+  if new is None or not old:
+    return ""
+  return "%.2fx" % (new / old)
+
+
+def report(results, baseline):
+  columns = ["program", "insts", "pass s", "peak MB", "calls", "calls opt", "run s"]
+  if baseline:
+    columns += ["pass vs base", "rss vs base", "calls vs base"]
+  rows = []
+  for name, result in results.items():
+    if "pass_seconds" not in result:
+      rows.append([name, str(result["instructions"]), result["error"]])
+      continue
+    row = [name, str(result["instructions"]), "%.3f" % result["pass_seconds"],
+           "%.1f" % (result["pass_peak_rss_kb"] / 1024.0), str(result["cat_calls_before"]),
+           str(result["cat_calls_after"]), "%.3f" % result["run_seconds"]]
+    old = baseline.get(name) if baseline else None
+    if baseline:
+      old = old or {}
+      row += [ratio(result["pass_seconds"], old.get("pass_seconds")),
+              ratio(result["pass_peak_rss_kb"], old.get("pass_peak_rss_kb")),
+              ratio(result["cat_calls_after"], old.get("cat_calls_after"))]
+    if "error" in result:
+      row.append(result["error"])
+    rows.append(row)
+  widths = [max(len(row[index]) for row in [columns] + rows if index < len(row)) for index in range(len(columns))]
+  for row in [columns] + rows:
+    print("  ".join(cell.ljust(widths[index]) if index < len(widths) else cell for index, cell in enumerate(row)))
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Benchmark the CAT pass.",
+                                   epilog="Arguments after -- are given to opt, for example: -- -cat-threads=4")
+  parser.add_argument("--pass", dest="pass_path", required=True, help="the CAT pass library (CAT.so)")
+  parser.add_argument("--llvm-bin", help="directory of opt, llvm-link and lli (default: the ones on PATH)")
+  parser.add_argument("--new-pm", action="store_true", help="run the pass with the new pass manager")
+  parser.add_argument("--work-dir", default="benchmark-work", help="where generated and optimized programs go")
+  parser.add_argument("--out", default="benchmark-results.json", help="JSON results file")
+  parser.add_argument("--baseline", help="JSON results of a previous run to compare against")
+  parser.add_argument("--repeat", type=int, default=1, help="runs of opt per program, the fastest one is reported")
+  parser.add_argument("--filter", action="append", default=[], help="only run the programs whose name contains this")
+  parser.add_argument("opt_args", nargs="*", help=argparse.SUPPRESS)
+  args = parser.parse_args()
+  args.pass_path = os.path.abspath(args.pass_path)
+  args.repeat = max(args.repeat, 1)
+
+  bindir = findLLVM(args.llvm_bin)
+  tool = lambda name: os.path.join(bindir, name)
+  work = os.path.abspath(args.work_dir)
+  baseline = None
+  if args.baseline:
+    with open(args.baseline) as old:
+      baseline = json.load(old)["programs"]
+
+  results = {}
+  for name, path in corpus(work, args.filter):
+    results[name] = benchmark(name, path, args, tool, work)
+
+  with open(args.out, "w") as out:
+    json.dump({"pass": args.pass_path, "new_pm": args.new_pm, "opt_args": args.opt_args, "programs": results}, out,
+              indent=2)
+  report(results, baseline)
+  if any("error" in result for result in results.values()):
+    sys.exit(1)
+
+
+if __name__ == "__main__":
+  main()
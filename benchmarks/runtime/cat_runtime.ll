@@ -0,0 +1,95 @@
+; A CAT runtime for running the benchmarks with lli.
+; Every CAT_* call bumps a counter, which is printed when the program exits, so the harness can tell how many CAT
+; calls the optimized program still executes.
+; The cat_bench_* functions are opaque to the pass: they live here, and are linked after the pass ran.
+
+declare i8* @malloc(i64)
+declare void @free(i8*)
+declare i32 @printf(i8*, ...)
+
+@cat_calls = internal global i64 0
+@cat_report = private constant [28 x i8] c"[CAT] calls executed: %ld\0A\00\00"
+
+@llvm.global_dtors = appending global [1 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 0, void ()* @cat_report_calls, i8* null }]
+
+define internal void @cat_count() {
+  %n = load i64, i64* @cat_calls
+  %m = add i64 %n, 1
+  store i64 %m, i64* @cat_calls
+  ret void
+}
+
+define internal void @cat_report_calls() {
+  %n = load i64, i64* @cat_calls
+  %fmt = getelementptr [28 x i8], [28 x i8]* @cat_report, i64 0, i64 0
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %n)
+  ret void
+}
+
+define i8* @CAT_new(i64 %value) {
+  call void @cat_count()
+  %data = call i8* @malloc(i64 8)
+  %slot = bitcast i8* %data to i64*
+  store i64 %value, i64* %slot
+  ret i8* %data
+}
+
+define void @CAT_add(i8* %result, i8* %a, i8* %b) {
+  call void @cat_count()
+  %pa = bitcast i8* %a to i64*
+  %pb = bitcast i8* %b to i64*
+  %pr = bitcast i8* %result to i64*
+  %va = load i64, i64* %pa
+  %vb = load i64, i64* %pb
+  %sum = add i64 %va, %vb
+  store i64 %sum, i64* %pr
+  ret void
+}
+
+define void @CAT_sub(i8* %result, i8* %a, i8* %b) {
+  call void @cat_count()
+  %pa = bitcast i8* %a to i64*
+  %pb = bitcast i8* %b to i64*
+  %pr = bitcast i8* %result to i64*
+  %va = load i64, i64* %pa
+  %vb = load i64, i64* %pb
+  %diff = sub i64 %va, %vb
+  store i64 %diff, i64* %pr
+  ret void
+}
+
+define void @CAT_set(i8* %data, i64 %value) {
+  call void @cat_count()
+  %slot = bitcast i8* %data to i64*
+  store i64 %value, i64* %slot
+  ret void
+}
+
+define i64 @CAT_get(i8* %data) {
+  call void @cat_count()
+  %slot = bitcast i8* %data to i64*
+  %value = load i64, i64* %slot
+  ret i64 %value
+}
+
+define void @CAT_destroy(i8* %data) {
+  call void @cat_count()
+  call void @free(i8* %data)
+  ret void
+}
+
+; modifies the CAT data it is given
+define void @cat_bench_touch(i8* %data) {
+  %slot = bitcast i8* %data to i64*
+  %value = load i64, i64* %slot
+  %next = add i64 %value, 100
+  store i64 %next, i64* %slot
+  ret void
+}
+
+; stores new CAT data through the pointer it is given
+define void @cat_bench_replace(i8** %ptr) {
+  %data = call i8* @CAT_new(i64 77)
+  store i8* %data, i8** %ptr
+  ret void
+}
@@ -13,409 +13,796 @@
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Transforms/Utils/LoopPeel.h"
+#include "llvm/Analysis/CodeMetrics.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/Analysis/CFG.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
 #include <map>
+#include <memory>
 #include <set>
-#include <unordered_set>
 #include <queue>
 
 using namespace llvm;
 #define UNKNOWN nullptr
 #define NO_CACHE nullptr
 #define cout errs()
+#define DEBUG_TYPE "CAT"
 
 namespace
 {
   typedef std::map<Value *, std::set<Instruction *>> RDASet;
   typedef std::map<Instruction *, RDASet> RDAMap;
-  typedef std::map<Value *, std::set<Value *>> AliasSet;
-  typedef std::map<Instruction *, AliasSet> AliasMap;
-  typedef std::map<Value *, Value *> CacheSet;
 
-  const std::unordered_set<std::string> ignoredFuncs = {"printf", "puts", "CAT_destroy", "sqrt", "rand"};
-  const std::unordered_set<std::string> catApis = {"CAT_new", "CAT_add", "CAT_sub", "CAT_set", "CAT_get", "CAT_destroy"};
-
-  struct CAT : public ModulePass
+  // a small set kept as a sorted vector, so it iterates in increasing order like std::set
+  // the facts are copied at every program point, and copying a flat set takes at most one allocation
+  template <typename T, unsigned N>
+  class SortedSet
   {
-    static char ID;
+  public:
+    typedef typename SmallVector<T, N>::const_iterator const_iterator;
 
-    CAT() : ModulePass(ID) {}
+    const_iterator begin() const { return items.begin(); }
+    const_iterator end() const { return items.end(); }
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    void clear() { items.clear(); }
 
-    enum VType
+    bool count(T item) const
     {
-      OTHER,
-      CAT_DATA,
-      CAT_PTR,
-    };
-
-    // sets for RDA
-    RDAMap IN, OUT;
-    AliasMap aliIN, aliOUT, ptIN, ptOUT;
-    std::set<Value *> allCATData, allCATPtr;
-    std::map<Instruction *, Instruction *> deleteMap;
-    std::map<Value *, Value *> propMap;
+      return std::binary_search(items.begin(), items.end(), item, std::less<T>());
+    }
 
-    Function *curFunc;
-    Module *curModule;
+    // returns true if item is new
+    bool insert(T item)
+    {
+      auto it = std::lower_bound(items.begin(), items.end(), item, std::less<T>());
+      if (it != items.end() && *it == item)
+        return false;
+      items.insert(it, item);
+      return true;
+    }
 
-    AliasAnalysis *AA;
+    void erase(T item)
+    {
+      auto it = std::lower_bound(items.begin(), items.end(), item, std::less<T>());
+      if (it != items.end() && *it == item)
+        items.erase(it);
+    }
 
-    // This function is invoked once at the initialization phase of the compiler
-    // The LLVM IR of functions isn't ready at this point
-    bool doInitialization(Module &M) override
+    // add the items of other, returns true if this set grows
+    bool unite(const SortedSet &other)
     {
-      curModule = &M;
-      return false;
+      if (other.items.empty() || &other == this)
+        return false;
+      if (items.empty())
+      {
+        items = other.items;
+        return true;
+      }
+      SmallVector<T, N> merged;
+      merged.reserve(items.size() + other.items.size());
+      std::set_union(items.begin(), items.end(), other.items.begin(), other.items.end(), std::back_inserter(merged), std::less<T>());
+      if (merged.size() == items.size())
+        return false;
+      items = std::move(merged);
+      return true;
     }
 
-    void resetGlobalMaps()
+    bool operator|=(const SortedSet &other) { return unite(other); }
+
+  private:
+    SmallVector<T, N> items;
+  };
+  typedef SortedSet<Value *, 2> ValueSet;
+  // definition numbers
+  typedef SortedSet<unsigned, 4> DefSet;
+
+  // the values each CAT pointer may point to
+  class AliasSet
+  {
+  public:
+    typedef DenseMap<Value *, ValueSet>::const_iterator const_iterator;
+
+    const_iterator begin() const { return sets.begin(); }
+    const_iterator end() const { return sets.end(); }
+
+    ValueSet &operator[](Value *ptr) { return sets[ptr]; }
+
+    // unlike operator[], it doesn't add ptr, so the references to the other sets stay valid
+    const ValueSet &lookup(Value *ptr) const
     {
-      IN.clear();
-      OUT.clear();
-      aliIN.clear();
-      aliOUT.clear();
-      ptIN.clear();
-      ptOUT.clear();
-      allCATData.clear();
-      allCATPtr.clear();
-      deleteMap.clear();
-      propMap.clear();
+      static const ValueSet none;
+      auto it = sets.find(ptr);
+      return it == sets.end() ? none : it->second;
     }
 
-    int getSize(Value *ptr)
+  private:
+    DenseMap<Value *, ValueSet> sets;
+  };
+  typedef std::map<Instruction *, AliasSet> AliasMap;
+  typedef std::map<Value *, Value *> CacheSet;
+
+  // alias classes of CAT values
+  // a class is named after the value that roots it (a CAT_new, an argument, a global, ...), and contains every value
+  // that may refer to the same CAT data: the root itself and the values derived from it through PHI, select, load, ...
+  // two values are aliases if they share a class, which usually means iterating the members of a single class
+  // copies share the classes until one of them is modified, which makes a snapshot per program point cheap
+  class AliasClasses
+  {
+  public:
+    bool contains(Value *v) const
     {
-      auto *ptrType = cast<PointerType>(ptr->getType())->getPointerElementType();
-      return ptrType->isSized() ? curModule->getDataLayout().getTypeStoreSize(ptrType) : 0;
+      return data && data->classesOf.find(v) != data->classesOf.end();
     }
 
-    bool mayModifiedByFunc(CallInst *callInst, Value *ptr)
+    // call f on every alias of v, including v itself
+    void forEachAlias(Value *v, function_ref<void(Value *)> f) const
     {
-      switch (AA->getModRefInfo(callInst, ptr, getSize(ptr)))
+      if (!data)
+        return;
+      auto it = data->classesOf.find(v);
+      if (it == data->classesOf.end())
+        return;
+
+      if (it->second.size() == 1)
       {
-      case ModRefInfo::Mod:
-      case ModRefInfo::ModRef:
-      case ModRefInfo::MustMod:
-        return true;
-      default:
-        return false;
+        for (auto *alias : data->members.find(it->second[0])->second)
+          f(alias);
+        return;
       }
+
+      SmallPtrSet<Value *, 16> visited;
+      for (auto *root : it->second)
+        for (auto *alias : data->members.find(root)->second)
+          if (visited.insert(alias).second)
+            f(alias);
     }
 
-    bool mayReferencedByFunc(CallInst *callInst, Value *ptr)
+    // v becomes an alias of itself only, returns false if v is already known
+    bool add(Value *v)
     {
-      switch (AA->getModRefInfo(callInst, ptr, getSize(ptr)))
-      {
-      case ModRefInfo::Ref:
-      case ModRefInfo::ModRef:
-      case ModRefInfo::MustRef:
-        return true;
-      default:
+      if (contains(v))
         return false;
-      }
+      auto &d = mutate();
+      d.classesOf[v].push_back(v);
+      d.members[v].push_back(v);
+      return true;
     }
 
-    void mergeAliasInfo(Value *source, Value *target, AliasSet &curAliIN, AliasSet &curAliOUT)
+    // v leaves all its classes and goes back to its own class
+    void reset(Value *v)
     {
-      for (auto *alias : curAliIN[source])
+      if (data)
       {
-        curAliOUT[target].insert(alias);
-        curAliOUT[alias].insert(target);
+        auto it = data->classesOf.find(v);
+        if (it != data->classesOf.end() && it->second.size() == 1 && it->second[0] == v && data->members[v].size() == 1)
+          return;
       }
-    }
 
-    VType checkType(Value *v)
-    {
-      if (allCATData.find(v) != allCATData.end())
-        return CAT_DATA;
-      else if (allCATPtr.find(v) != allCATPtr.end())
-        return CAT_PTR;
-      else
-        return OTHER;
+      auto &d = mutate();
+      for (auto *root : d.classesOf[v])
+        leave(d, root, v);
+      d.classesOf[v].assign(1, v);
+      d.members[v].push_back(v);
     }
 
-    void resetAliasInfo(Value *v, AliasSet &curAliIN, AliasSet &curAliOUT)
+    // v joins every class that source belongs to in from, returns true if v joins a new class
+    bool join(Value *v, Value *source, const AliasClasses &from)
     {
-      for (auto *alias : curAliIN[v])
-        curAliOUT[alias].erase(v);
-      curAliOUT[v].clear();
-      curAliOUT[v].insert(v);
+      if (!from.data)
+        return false;
+      auto it = from.data->classesOf.find(source);
+      if (it == from.data->classesOf.end())
+        return false;
+      // the classes of source must be copied, as from may share the data that is about to be modified
+      SmallVector<Value *, 2> roots(it->second.begin(), it->second.end());
+
+      bool changed = false;
+      for (auto *root : roots)
+        changed |= joinClass(v, root);
+      if (!changed)
+        return false;
+
+      // the own class of v is redundant once it is in another class, unless other values derive from v
+      auto &d = *data;
+      auto &classes = d.classesOf[v];
+      auto own = llvm::find(classes, v);
+      if (own != classes.end() && classes.size() > 1 && d.members[v].size() == 1)
+      {
+        classes.erase(own);
+        d.members.erase(v);
+      }
+      return true;
     }
 
-    void addDef(Value *v, Instruction *def, AliasSet &aliases, RDASet &curOUT)
+    // the union of both alias relations, returns true if this relation grows
+    bool merge(const AliasClasses &other)
     {
-      if (aliases.find(v) == aliases.end())
+      if (!other.data || other.data == data)
+        return false;
+      if (!data)
       {
-        cout << "[WARNING] " << *v << " alias not init!\n";
-        aliases[v].insert(v);
+        data = other.data;
+        return !data->classesOf.empty();
       }
 
-      for (auto *alias : aliases[v])
-        curOUT[alias].insert(def);
+      bool changed = false;
+      for (auto &pair : other.data->classesOf)
+        for (auto *root : pair.second)
+          changed |= joinClass(pair.first, root);
+      return changed;
     }
 
-    void setDef(Value *v, Instruction *def, AliasSet &aliases, RDASet &curOUT)
+  private:
+    struct Data
     {
-      curOUT[v].clear();
-      addDef(v, def, aliases, curOUT);
+      DenseMap<Value *, SmallVector<Value *, 2>> classesOf;
+      DenseMap<Value *, SmallVector<Value *, 4>> members;
+    };
+
+    Data &mutate()
+    {
+      if (!data)
+        data = std::make_shared<Data>();
+      else if (data.use_count() > 1)
+        data = std::make_shared<Data>(*data);
+      return *data;
     }
 
-    void addPointTo(Value *ptr, Value *val, AliasSet &aliases, AliasSet &curPtOUT)
+    bool joinClass(Value *v, Value *root)
     {
-      if (aliases.find(ptr) == aliases.end())
+      if (data)
       {
-        cout << "[WARNING] " << *ptr << " alias not init!\n";
-        aliases[ptr].insert(ptr);
+        auto it = data->classesOf.find(v);
+        if (it != data->classesOf.end() && llvm::is_contained(it->second, root))
+          return false;
       }
+      auto &d = mutate();
+      d.classesOf[v].push_back(root);
+      d.members[root].push_back(v);
+      return true;
+    }
 
-      for (auto *alias : aliases[ptr])
-        curPtOUT[alias].insert(val);
+    static void leave(Data &d, Value *root, Value *v)
+    {
+      auto it = d.members.find(root);
+      if (it == d.members.end())
+        return;
+      auto &members = it->second;
+      members.erase(llvm::find(members, v));
+      if (members.empty())
+        d.members.erase(it);
     }
 
-    void setPointTo(Value *ptr, Value *val, AliasSet &aliases, AliasSet &curPtOUT)
+    std::shared_ptr<Data> data;
+  };
+  typedef std::map<Instruction *, AliasClasses> AliasClassMap;
+
+  // facts of the block engine: for each CAT value number, the set of definition numbers reaching it
+  struct BlockRDASet
+  {
+    std::vector<DefSet> defs;
+  };
+
+  // the block engine only keeps the facts at the exit of each block
+  // the facts at its entry are merged from the exits of its predecessors when they are needed
+  struct BlockFacts
+  {
+    bool visited = false;
+    BlockRDASet rdaOUT;
+    AliasClasses aliOUT;
+    AliasSet ptOUT;
+  };
+
+  // the CAT side effects of a defined function, computed bottom-up on the call graph
+  // recursive functions, and functions that call unknown code or write pointers to memory, get no summary
+  struct FunctionSummary
+  {
+    // the CAT data arguments and globals that the function may modify, read, or return
+    std::set<unsigned> modifiedArgs, readArgs, returnedArgs;
+    std::set<GlobalVariable *> modifiedGlobals, readGlobals, returnedGlobals;
+    // the function may read CAT data loaded from memory
+    bool readsUnknown = false;
+    // the return value may be CAT data created by the function, and then it's always this constant
+    bool returnsFresh = false;
+    ConstantInt *returnConstant = nullptr;
+  };
+
+  // what a call to a non-CAT function can touch, independent of the facts at the call
+  // the answers of alias analysis never change during the analysis, so they are asked once per call site
+  struct CallSiteSummary
+  {
+    // CAT values passed in directly, as globals or arguments
+    ValueSet dataPassedIn, ptrPassedIn;
+    // the passed in pointers whose pointees can be read, and the ones that can be written
+    std::vector<Value *> ptrReferenced;
+    ValueSet ptrModified;
+    // lazily filled answers for the data reached through the pointers
+    DenseMap<Value *, bool> dataModified, aliasesReturn;
+
+    // set when the summary of the callee applies, and then the call modifies and returns only these
+    bool summarized = false;
+    std::vector<Value *> killedData, returnedData;
+    bool returnsFresh = false;
+    ConstantInt *returnConstant = nullptr;
+  };
+
+  enum RDAEngineKind
+  {
+    MAP_RDA,
+    BLOCK_RDA,
+    // the deprecated name of BLOCK_RDA, replaced by it as soon as it's parsed
+    BITVECTOR_RDA,
+  };
+
+  enum InlineMode
+  {
+    INLINE_ALL,
+    INLINE_SELECTIVE,
+  };
+
+  cl::opt<RDAEngineKind> RDAEngine(
+      "cat-rda-engine", cl::desc("Reaching definitions engine used by the CAT pass"),
+      cl::values(clEnumValN(MAP_RDA, "map", "per-instruction std::map facts"),
+                 clEnumValN(BLOCK_RDA, "block", "per-block sorted definition sets, with every CAT use linked after the fixed point"),
+                 // the name of the block engine before its sets stopped being bit vectors
+                 clEnumValN(BITVECTOR_RDA, "bitvector", "deprecated alias of block")),
+      cl::init(BLOCK_RDA), cl::callback([](const RDAEngineKind &engine)
+                                        {
+                                          if (engine != BITVECTOR_RDA)
+                                            return;
+                                          cout << "[WARNING] -cat-rda-engine=bitvector is deprecated, use -cat-rda-engine=block\n";
+                                          RDAEngine = BLOCK_RDA; }));
+  cl::opt<bool> VerifyRDA("cat-verify-rda", cl::desc("Run both RDA engines and report where their results differ"), cl::init(false));
+  cl::opt<InlineMode> InlinePolicy(
+      "cat-inline", cl::desc("Which functions the CAT pass marks always-inline"),
+      cl::values(clEnumValN(INLINE_ALL, "all", "every defined function"),
+                 clEnumValN(INLINE_SELECTIVE, "selective", "only the functions whose CAT effects block folding, within a size budget")),
+      cl::init(INLINE_ALL));
+  cl::opt<unsigned> InlineCalleeSize("cat-inline-callee-size", cl::desc("Largest function, in instructions, inlined by the selective policy"), cl::init(500));
+  cl::opt<unsigned> InlineBudget("cat-inline-budget", cl::desc("Instructions the selective policy may add to the module"), cl::init(5000));
+  cl::opt<bool> ReportInlining("cat-report-inlining", cl::desc("Report the IR growth of the inlining policy"), cl::init(false));
+  cl::opt<bool> UseFunctionSummaries("cat-function-summaries", cl::desc("Use the CAT side effects of the callees at call sites"), cl::init(true));
+  cl::opt<unsigned> AnalysisThreads("cat-threads", cl::desc("Threads running the RDA of independent functions, 0 for one per core"), cl::init(1));
+  cl::opt<bool> ReportIterations("cat-report-iterations", cl::desc("Report the number of block visits needed by the RDA fixed point"), cl::init(false));
+  cl::opt<unsigned> MaxPeelCount("cat-max-peel-count", cl::desc("Most iterations peeled off a loop whose CAT reads only fold in its first iterations"), cl::init(2));
+  cl::opt<unsigned> LoopRounds("cat-loop-rounds", cl::desc("Rounds of loop transformations, each followed by a new analysis and folding of the function"), cl::init(4));
+  cl::opt<unsigned> LoopSizeLimit("cat-loop-size-limit", cl::desc("Largest loop, in instructions, peeled or unrolled"), cl::init(500));
+  cl::opt<unsigned> LoopGrowthBudget("cat-loop-budget", cl::desc("Instructions the loop transformations may add to the module"), cl::init(5000));
+  cl::opt<bool> ReportLoops("cat-report-loops", cl::desc("Report how each loop using CAT APIs is unrolled or peeled, and why"), cl::init(false));
+  cl::opt<bool> EliminateRedundantCalls("cat-cse", cl::desc("Replace the CAT_get and remove the CAT_add and CAT_sub that repeat an earlier call on the same data"), cl::init(true));
+  cl::opt<bool> HoistInvariants("cat-licm", cl::desc("Hoist the loop-invariant CAT calls out of loops, and sink the CAT_set no read of the loop sees"), cl::init(true));
+  cl::opt<bool> EliminateDeadCode("cat-dead-code", cl::desc("Remove the CAT definitions no read sees, and the CAT objects that don't escape and aren't read"), cl::init(true));
+  cl::opt<bool> ScalarReplacement("cat-scalar-replacement", cl::desc("Replace the CAT objects only CAT calls of their function use by i64 values"), cl::init(true));
+  cl::opt<bool> BatchHeapAccesses("cat-batch", cl::desc("Read and write the heap objects once per run of calls when lowering the calls that mix them with replaced ones"), cl::init(true));
+  cl::opt<bool> UseProfile("cat-use-profile", cl::desc("Transform only the hot loops and inline only the hot call sites of modules with a profile"), cl::init(true));
+  cl::opt<std::string> CacheDir("cat-cache-dir", cl::desc("Skip the functions this on-disk cache finds unchanged by earlier runs of the pass"),
+                                cl::value_desc("directory"));
+  cl::opt<std::string> DiagnosticsFile("cat-diagnostics", cl::desc("Write the folds, the propagations and the blocked folds of the pass as JSON lines to this file, - for stderr"),
+                                       cl::value_desc("filename"));
+  cl::opt<std::string> DiagnosticsFunction("cat-diagnostics-function", cl::desc("Only diagnose the functions whose name matches this regular expression"),
+                                           cl::value_desc("regex"));
+  cl::opt<std::string> DiagnosticsValue("cat-diagnostics-value", cl::desc("Only diagnose the CAT calls with this operand"), cl::value_desc("name"));
+  cl::opt<std::string> DiagnosticsRange("cat-diagnostics-range", cl::desc("Only diagnose the CAT calls with these instruction numbers in their function"),
+                                        cl::value_desc("first:last"));
+
+  // printed with -stats, or as JSON with -stats-json, whatever the build type
+  ALWAYS_ENABLED_STATISTIC(NumFunctions, "Functions analyzed");
+  ALWAYS_ENABLED_STATISTIC(NumCachedFunctions, "Functions skipped because the analysis cache finds them unchanged");
+  ALWAYS_ENABLED_STATISTIC(NumTypeVisits, "Values visited by the type inference worklist");
+  ALWAYS_ENABLED_STATISTIC(NumRDAVisits, "Block visits of the RDA fixed point");
+  ALWAYS_ENABLED_STATISTIC(NumFoldVisits, "Calls visited by the folding fixed point");
+  ALWAYS_ENABLED_STATISTIC(NumFolds, "CAT_add and CAT_sub folded into a constant CAT_set");
+  ALWAYS_ENABLED_STATISTIC(NumAlgSimps, "CAT_add and CAT_sub simplified algebraically");
+  ALWAYS_ENABLED_STATISTIC(NumProps, "CAT_get replaced by a constant");
+  ALWAYS_ENABLED_STATISTIC(NumLoopsPeeled, "Loops peeled");
+  ALWAYS_ENABLED_STATISTIC(NumLoopsUnrolled, "Loops unrolled");
+  ALWAYS_ENABLED_STATISTIC(NumLoopsFullyUnrolled, "Loops fully unrolled");
+  ALWAYS_ENABLED_STATISTIC(NumLoopsRuntimeUnrolled, "Loops unrolled with a runtime remainder");
+  ALWAYS_ENABLED_STATISTIC(NumLoopsOverBudget, "Loop transformations left out by the growth budget");
+  ALWAYS_ENABLED_STATISTIC(NumRedundantGets, "CAT_get replaced by an earlier CAT_get of the same data");
+  ALWAYS_ENABLED_STATISTIC(NumRedundantDefs, "CAT_add and CAT_sub repeating an earlier one removed");
+  ALWAYS_ENABLED_STATISTIC(NumDeadDefs, "Dead CAT_set, CAT_add and CAT_sub removed");
+  ALWAYS_ENABLED_STATISTIC(NumDeadGets, "Unused CAT_get removed");
+  ALWAYS_ENABLED_STATISTIC(NumDeadObjects, "CAT_new of objects that don't escape removed with their CAT_destroy");
+  ALWAYS_ENABLED_STATISTIC(NumHoisted, "Loop-invariant CAT calls hoisted to the preheader");
+  ALWAYS_ENABLED_STATISTIC(NumSunk, "CAT_set sunk to the exit of their loop");
+  ALWAYS_ENABLED_STATISTIC(NumPromotedObjects, "CAT objects that don't escape replaced by i64 values");
+  ALWAYS_ENABLED_STATISTIC(NumBatchedAccesses, "CAT_get and CAT_set of heap objects saved by lowering mixed calls in batches");
+  ALWAYS_ENABLED_STATISTIC(NumColdLoops, "Loops using CAT APIs left alone because the profile finds them cold");
+  ALWAYS_ENABLED_STATISTIC(NumColdCallSites, "Call sites left out of inlining because the profile finds them cold");
+  ALWAYS_ENABLED_STATISTIC(MaxRDAPoints, "Most instructions with RDA facts in a function (map engine)");
+  ALWAYS_ENABLED_STATISTIC(MaxRDABlocks, "Most blocks with RDA facts in a function (block engine)");
+  ALWAYS_ENABLED_STATISTIC(MaxReachingDefs, "Most definitions reaching the exit of a block");
+  ALWAYS_ENABLED_STATISTIC(MaxDefUseNodes, "Most def-use nodes in a function");
+
+  TrackingStatistic *const catStatistics[] = {&NumFunctions, &NumCachedFunctions, &NumTypeVisits, &NumRDAVisits, &NumFoldVisits, &NumFolds, &NumAlgSimps,
+                                              &NumProps, &NumRedundantGets, &NumRedundantDefs, &NumDeadDefs, &NumDeadGets, &NumDeadObjects, &NumHoisted, &NumSunk, &NumPromotedObjects, &NumBatchedAccesses, &NumLoopsPeeled, &NumLoopsUnrolled, &NumLoopsFullyUnrolled,
+                                              &NumLoopsRuntimeUnrolled, &NumLoopsOverBudget, &NumColdLoops, &NumColdCallSites, &MaxRDAPoints,
+                                              &MaxRDABlocks, &MaxReachingDefs, &MaxDefUseNodes};
+
+  cl::opt<std::string> StatsJSON("cat-stats-json", cl::desc("Write the statistics and the phase timings of the pass as JSON to this file"),
+                                 cl::value_desc("filename"));
+
+  // the phases of the pass, timed with -time-passes or -cat-stats-json
+  // the timers are only used on the thread of the pass
+  struct PhaseTimers
+  {
+    TimerGroup group{"cat", "CAT pass"};
+    Timer typeInfo{"type-info", "Type inference", group};
+    Timer rda{"rda", "Reaching definitions", group};
+    Timer fold{"fold", "Constant folding and algebraic simplification", group};
+    Timer prop{"prop", "Constant propagation", group};
+    Timer loops{"loops", "Loop unrolling and peeling", group};
+    Timer cse{"cse", "Redundant CAT call elimination", group};
+    Timer dce{"dce", "Dead CAT code elimination", group};
+    Timer licm{"licm", "Loop-invariant CAT call motion", group};
+    Timer sroa{"sroa", "Scalar replacement of CAT objects", group};
+    Timer cache{"cache", "Analysis cache lookups", group};
+
+    // the JSON is written at shutdown, when the counters and timers of all the runs are final
+    ~PhaseTimers()
     {
-      curPtOUT[ptr].clear();
-      addPointTo(ptr, val, aliases, curPtOUT);
+      if (!StatsJSON.empty())
+        writeJSON();
+      // the timings were only collected for the JSON
+      if (!TimePassesIsEnabled)
+        group.clear();
     }
 
-    std::set<Value *> findAllPossibleCATData(Value *ptr, AliasSet &curPtIN)
+    void writeJSON()
     {
-      std::set<Value *> possibleCATData;
-      for (auto *pointed : curPtIN[ptr])
+      std::error_code EC;
+      raw_fd_ostream OS(StatsJSON, EC, sys::fs::OF_Text);
+      if (EC)
       {
-        if (pointed == UNKNOWN)
-        {
-          possibleCATData.insert(UNKNOWN);
-          continue;
-        }
-
-        switch (checkType(pointed))
-        {
-        case CAT_DATA:
-          possibleCATData.insert(pointed);
-          break;
-        case OTHER:
-          break;
-        case CAT_PTR:
-          auto rst = findAllPossibleCATData(pointed, curPtIN);
-          possibleCATData.insert(rst.begin(), rst.end());
-          break;
-        }
+        cout << "[WARNING] can't write the statistics to " << StatsJSON << ": " << EC.message() << "\n";
+        return;
       }
-
-      return possibleCATData;
+      OS << "{\n";
+      const char *delim = "";
+      for (auto *stat : catStatistics)
+      {
+        OS << delim << "\t\"" << stat->getDebugType() << "." << stat->getName() << "\": " << stat->getValue();
+        delim = ",\n";
+      }
+      group.printJSONValues(OS, delim);
+      OS << "\n}\n";
     }
+  };
+  ManagedStatic<PhaseTimers> phaseTimers;
 
-    void collectTypeInfo()
+  bool timingEnabled()
+  {
+    return TimePassesIsEnabled || !StatsJSON.empty();
+  }
+
+  TimeRegion timePhase(Timer PhaseTimers::*timer)
+  {
+    return TimeRegion(timingEnabled() ? &((*phaseTimers).*timer) : nullptr);
+  }
+
+  // the JSON is written even if no phase ran
+  void requestStatsJSON()
+  {
+    if (!StatsJSON.empty())
+      (void)*phaseTimers;
+  }
+
+  // the stream and the filters of -cat-diagnostics, set up by the first function diagnosed
+  // the events are only written on the thread of the pass
+  struct Diagnostics
+  {
+    std::unique_ptr<raw_fd_ostream> file;
+    raw_ostream *OS = nullptr;
+    Regex function;
+    unsigned first = 0, last = UINT_MAX;
+    // the number of times each function was folded
+    DenseMap<Function *, unsigned> foldings;
+
+    Diagnostics() : function(DiagnosticsFunction)
     {
-      while (true)
+      std::string error;
+      if (!DiagnosticsFunction.empty() && !function.isValid(error))
+        cout << "[WARNING] invalid -cat-diagnostics-function: " << error << "\n";
+      StringRef range = DiagnosticsRange;
+      // either bound may be left out, and a single number selects one instruction
+      if (!range.empty())
       {
-        bool fixed = false;
-        for (auto &B : *curFunc)
-          fixed |= collectTypeInfoInBB(B);
-        if (!fixed)
-          break;
+        auto bounds = range.split(':');
+        if (!range.contains(':'))
+          bounds.second = bounds.first;
+        if ((!bounds.first.empty() && bounds.first.getAsInteger(10, first)) || (!bounds.second.empty() && bounds.second.getAsInteger(10, last)))
+          cout << "[WARNING] invalid -cat-diagnostics-range, expected <first>:<last>: " << range << "\n";
       }
 
-      // sweep the type info in the whole function
-      sweepTypeInfoInBB();
+      if (DiagnosticsFile == "-")
+      {
+        OS = &errs();
+        return;
+      }
+      std::error_code EC;
+      file = std::make_unique<raw_fd_ostream>(DiagnosticsFile, EC, sys::fs::OF_Text);
+      if (EC)
+        cout << "[WARNING] can't write the diagnostics to " << DiagnosticsFile << ": " << EC.message() << "\n";
+      else
+        OS = file.get();
     }
 
-    void sortAccordingToType(Value *v)
+    bool matchesFunction(StringRef name)
     {
-      if (!v->getType()->isPointerTy() || checkType(v) != OTHER)
-        return;
-      auto *ptrType = cast<PointerType>(v->getType());
-      if (ptrType->getPointerElementType()->isIntegerTy(8))
-        allCATData.insert(v);
-      else
-        allCATPtr.insert(v);
+      return OS && (DiagnosticsFunction.empty() || !function.isValid() || function.match(name));
     }
 
-    void sweepTypeInfoInBB()
+    bool matchesNumber(unsigned number)
     {
-      // sweep globals
-      for (auto &GV : curModule->globals())
-        if (auto *ptrType = dyn_cast<PointerType>(GV.getType()))
-        {
-          if (checkType(&GV) != OTHER)
-            continue;
-          if (ptrType->getPointerElementType()->isIntegerTy(8))
-            allCATData.insert(&GV);
-          else
-            allCATPtr.insert(&GV);
-        }
+      return number >= first && number <= last;
+    }
 
-      for (auto &BB : *curFunc)
-        for (auto &I : BB)
-        {
-          if (auto *allocaInst = dyn_cast<AllocaInst>(&I))
-            sortAccordingToType(allocaInst);
-          else if (auto *phiNode = dyn_cast<PHINode>(&I))
-            sortAccordingToType(phiNode);
-          else if (auto *selectInst = dyn_cast<SelectInst>(&I))
-            sortAccordingToType(selectInst);
-          else if (auto *storeInst = dyn_cast<StoreInst>(&I))
-          {
-            sortAccordingToType(storeInst->getPointerOperand());
-            sortAccordingToType(storeInst->getValueOperand());
-          }
-          else if (auto *loadInst = dyn_cast<LoadInst>(&I))
-          {
-            sortAccordingToType(loadInst->getPointerOperand());
-            sortAccordingToType(loadInst);
-          }
-          else if (auto *bitcastInst = dyn_cast<BitCastInst>(&I))
-          {
-            sortAccordingToType(bitcastInst);
-            sortAccordingToType(bitcastInst->getOperand(0));
-          }
-          else if (auto *callInst = dyn_cast<CallInst>(&I))
-            sortAccordingToType(callInst);
-        }
+    void write(json::Object event)
+    {
+      *OS << json::Value(std::move(event)) << "\n";
     }
+  };
+  ManagedStatic<Diagnostics> diagnostics;
 
-    bool collectTypeInfoInBB(BasicBlock &BB)
+  // worklist of blocks popped in reverse post-order, where a block is never queued twice
+  class BlockWorklist
+  {
+  public:
+    explicit BlockWorklist(Function &F)
     {
-      auto oldDataSize = allCATData.size(), oldPtrSize = allCATPtr.size();
-      for (auto &I : BB)
-      {
-        if (auto *allocaInst = dyn_cast<AllocaInst>(&I))
-          allCATPtr.insert(allocaInst);
-        else if (auto *phiNode = dyn_cast<PHINode>(&I))
-        {
-          int n = phiNode->getNumIncomingValues();
-          switch (checkType(phiNode))
-          {
-          case CAT_DATA:
-            for (int i = 0; i < n; i++)
-              allCATData.insert(phiNode->getIncomingValue(i));
-            break;
-          case CAT_PTR:
-            for (int i = 0; i < n; i++)
-              allCATPtr.insert(phiNode->getIncomingValue(i));
-            break;
-          case OTHER:
-            for (int i = 0; i < n; i++)
-            {
-              switch (checkType(phiNode->getIncomingValue(i)))
-              {
-              case CAT_DATA:
-                allCATData.insert(phiNode);
-                break;
-              case CAT_PTR:
-                allCATPtr.insert(phiNode);
-                break;
-              case OTHER:
-                break;
-              }
-            }
-            break;
-          }
-        }
-        else if (auto *selectInst = dyn_cast<SelectInst>(&I))
-        {
-          auto *op1 = selectInst->getOperand(1), *op2 = selectInst->getOperand(2);
-          switch (checkType(selectInst))
-          {
-          case CAT_DATA:
-            allCATData.insert(op1);
-            allCATData.insert(op2);
-            break;
-          case CAT_PTR:
-            allCATPtr.insert(op1);
-            allCATPtr.insert(op2);
-            break;
-          case OTHER:
-            // if can't find type, then check the type of operands
-            for (auto *op : {op1, op2})
-              switch (checkType(op))
-              {
-              case CAT_DATA:
-                allCATData.insert(op);
-                break;
-              case CAT_PTR:
-                allCATPtr.insert(op);
-                break;
-              case OTHER:
-                break;
-              }
-            break;
-          }
-        }
-        else if (auto *storeInst = dyn_cast<StoreInst>(&I))
-          switch (checkType(storeInst->getValueOperand()))
-          {
-          case CAT_DATA:
-          case CAT_PTR:
-            allCATPtr.insert(storeInst->getPointerOperand());
-            break;
-          case OTHER:
-            break;
-          }
-        else if (auto *loadInst = dyn_cast<LoadInst>(&I))
-        {
-          switch (checkType(loadInst))
-          {
-          case CAT_DATA:
-          case CAT_PTR:
-            allCATPtr.insert(loadInst->getPointerOperand());
-            break;
-          case OTHER:
-            break;
-          }
-        }
-        else if (auto *callInst = dyn_cast<CallInst>(&I))
-        {
-          auto calledName = callInst->getCalledFunction()->getName();
-          if (calledName.equals("CAT_new"))
-            allCATData.insert(callInst);
-          else if (calledName.equals("CAT_get") || calledName.equals("CAT_set") || calledName.equals("CAT_destroy"))
-            allCATData.insert(callInst->getArgOperand(0));
-          else if (calledName.equals("CAT_add") || calledName.equals("CAT_sub"))
-            for (int i = 0; i < 3; i++)
-              allCATData.insert(callInst->getArgOperand(i));
-        }
-      }
-      return allCATData.size() != oldDataSize || allCATPtr.size() != oldPtrSize;
+      ReversePostOrderTraversal<Function *> RPOT(&F);
+      for (auto *BB : RPOT)
+        addBlock(BB);
+      // blocks unreachable from the entry go last
+      for (auto &BB : F)
+        if (order.find(&BB) == order.end())
+          addBlock(&BB);
+      inQueue.resize(blocks.size());
+    }
+
+    void push(BasicBlock *BB)
+    {
+      auto idx = order[BB];
+      if (inQueue[idx])
+        return;
+      inQueue.set(idx);
+      queue.push(idx);
+    }
+
+    BasicBlock *pop()
+    {
+      auto idx = queue.top();
+      queue.pop();
+      inQueue.reset(idx);
+      return blocks[idx];
+    }
+
+    bool empty() const { return queue.empty(); }
+    unsigned size() const { return blocks.size(); }
+
+  private:
+    void addBlock(BasicBlock *BB)
+    {
+      order[BB] = blocks.size();
+      blocks.push_back(BB);
     }
 
-    enum InstType
+    DenseMap<BasicBlock *, unsigned> order;
+    std::vector<BasicBlock *> blocks;
+    BitVector inQueue;
+    // the smallest RPO number has the highest priority
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> queue;
+  };
+
+  // sparse def-use graph of CAT data, in the spirit of memory SSA
+  // every CAT data operand of a CAT instruction is linked to a node holding the definitions that reach it
+  // nodes are shared by all the operands reached by the same definitions, so the nodes of several definitions
+  // are the memory phis of the join points and of the aliases, and the graph takes O(operands + nodes)
+  // the nodes and their definitions live in an arena, which is freed in one go with the graph
+  class DefUseGraph
+  {
+  public:
+    struct Node
     {
-      PHI,
-      SELECT,
-      ALLOCA,
-      STORE,
-      LOAD,
-      BITCAST,
-      CAT_NEW,
-      CAT_MOD,
-      CAT_GET,
-      MISC_FUNC,
-      IGNORED
+      ArrayRef<unsigned> defs;
+      // the constant defined by all the definitions, once it can't change anymore
+      bool final = false;
+      ConstantInt *constant = nullptr;
     };
 
-    InstType getInstType(Instruction &I)
+    void link(Instruction *user, Value *operand, const DefSet &defs)
     {
-      if (auto *callInst = dyn_cast<CallInst>(&I))
+      auto it = nodeIds.find(ArrayRef<unsigned>(defs.begin(), defs.end()));
+      if (it != nodeIds.end())
       {
-        auto calledName = callInst->getCalledFunction()->getName();
-        if (calledName.equals("CAT_new"))
-          return CAT_NEW;
-        else if (calledName.equals("CAT_add") || calledName.equals("CAT_sub") || calledName.equals("CAT_set"))
+        uses[{user, operand}] = it->second;
+        return;
+      }
+
+      auto *copy = defs.empty() ? nullptr : arena.Allocate<unsigned>(defs.size());
+      std::copy(defs.begin(), defs.end(), copy);
+      auto *node = new (arena.Allocate<Node>()) Node();
+      node->defs = makeArrayRef(copy, defs.size());
+      nodeIds[node->defs] = node;
+      uses[{user, operand}] = node;
+      numNodes++;
+    }
+
+    // a new instruction uses the operand with the same definitions as another one
+    void copy(Instruction *user, Instruction *from, Value *operand)
+    {
+      auto it = uses.find({from, operand});
+      if (it != uses.end())
+        uses[{user, operand}] = it->second;
+    }
+
+    Node *find(Instruction *user, Value *operand)
+    {
+      auto it = uses.find({user, operand});
+      return it == uses.end() ? nullptr : it->second;
+    }
+
+    void clear()
+    {
+      nodeIds.clear();
+      uses.clear();
+      arena.Reset();
+      numNodes = 0;
+    }
+
+    size_t size() const
+    {
+      return numNodes;
+    }
+
+  private:
+    // nodes are trivially destructible, so the arena never runs their destructors
+    BumpPtrAllocator arena;
+    DenseMap<ArrayRef<unsigned>, Node *> nodeIds;
+    DenseMap<std::pair<Instruction *, Value *>, Node *> uses;
+    size_t numNodes = 0;
+  };
+
+  // the functions the pass knows, resolved once per module by name
+  enum CATApi
+  {
+    NOT_API,
+    API_NEW,
+    API_ADD,
+    API_SUB,
+    API_SET,
+    API_GET,
+    API_DESTROY,
+    // library functions without effects on CAT data
+    API_IGNORED,
+  };
+
+  const StringMap<CATApi> knownFuncs = {{"CAT_new", API_NEW}, {"CAT_add", API_ADD}, {"CAT_sub", API_SUB}, {"CAT_set", API_SET}, {"CAT_get", API_GET}, {"CAT_destroy", API_DESTROY}, {"printf", API_IGNORED}, {"puts", API_IGNORED}, {"sqrt", API_IGNORED}, {"rand", API_IGNORED}};
+
+  enum VType
+  {
+    OTHER,
+    CAT_DATA,
+    CAT_PTR,
+  };
+
+  enum InstType
+  {
+    PHI,
+    SELECT,
+    ALLOCA,
+    STORE,
+    LOAD,
+    BITCAST,
+    CAT_NEW,
+    CAT_MOD,
+    CAT_GET,
+    MISC_FUNC,
+    IGNORED
+  };
+
+  typedef std::map<Function *, FunctionSummary> FunctionSummaryMap;
+
+  const FunctionSummary *findFunctionSummary(const FunctionSummaryMap &funcSummaries, Function *F)
+  {
+    if (!F || !UseFunctionSummaries)
+      return nullptr;
+    auto it = funcSummaries.find(F);
+    return it == funcSummaries.end() ? nullptr : &it->second;
+  }
+
+  // what the pass knows about a module before analyzing its functions:
+  // the declarations of the CAT API and the CAT types of the globals, classified by the type they point to
+  struct ModuleInfo
+  {
+    DenseMap<const Function *, CATApi> apis;
+    Function *apiDecls[API_IGNORED] = {};
+    DenseMap<Value *, VType> globalTypes;
+    std::vector<GlobalVariable *> catGlobals;
+
+    ModuleInfo(Module &M)
+    {
+      for (auto &F : M)
+      {
+        auto it = knownFuncs.find(F.getName());
+        CATApi api = it != knownFuncs.end() ? it->second : NOT_API;
+        if (api == NOT_API && F.getName().startswith("llvm.lifetime"))
+          api = API_IGNORED;
+        if (api == NOT_API)
+          continue;
+        apis[&F] = api;
+        if (api != API_IGNORED)
+          apiDecls[api] = &F;
+      }
+
+      for (auto &GV : M.globals())
+        if (auto *ptrType = dyn_cast<PointerType>(GV.getType()))
+        {
+          globalTypes[&GV] = ptrType->getPointerElementType()->isIntegerTy(8) ? CAT_DATA : CAT_PTR;
+          catGlobals.push_back(&GV);
+        }
+    }
+
+    // indirect calls and calls to unknown functions are NOT_API
+    CATApi getApi(const CallInst *callInst) const
+    {
+      auto it = apis.find(callInst->getCalledFunction());
+      return it == apis.end() ? NOT_API : it->second;
+    }
+
+    InstType getInstType(Instruction &I) const
+    {
+      if (auto *callInst = dyn_cast<CallInst>(&I))
+        switch (getApi(callInst))
+        {
+        case API_NEW:
+          return CAT_NEW;
+        case API_ADD:
+        case API_SUB:
+        case API_SET:
           return CAT_MOD;
-        else if (calledName.equals("CAT_get"))
+        case API_GET:
           return CAT_GET;
-        else if (ignoredFuncs.find(calledName.str()) == ignoredFuncs.end() && !calledName.startswith("llvm.lifetime"))
+        case NOT_API:
           return MISC_FUNC;
-        else
+        default:
           return IGNORED;
-      }
+        }
       else if (I.getType()->isPointerTy() && isa<PHINode>(I))
         return PHI;
       else if (I.getType()->isPointerTy() && isa<SelectInst>(I))
@@ -430,744 +817,3217 @@ namespace
         return BITCAST;
       return IGNORED;
     }
+  };
 
-    bool RDAinBB(BasicBlock &BB)
+  // the state and the analyses of one function
+  // contexts of different functions are independent, so they can be analyzed concurrently as long as the IR isn't mutated
+  struct FunctionContext
+  {
+    FunctionContext(Function &F, const FunctionSummaryMap &funcSummaries, std::shared_ptr<const ModuleInfo> moduleInfo)
+        : curFunc(&F), curModule(F.getParent()), funcSummaries(&funcSummaries), moduleInfo(std::move(moduleInfo))
     {
-      RDASet curIN, curOUT;
-      AliasSet curAliIN, curAliOUT, curPtIN, curPtOUT;
-      // create two temporary sets for comparing old OUT and new OUT
-      std::unordered_set<Instruction *> oldOut, newOut;
-      bool firstTime = true;
+      // definition number 0 is always UNKNOWN
+      defList.assign(1, UNKNOWN);
+      for (auto &BB : F)
+        for (auto &I : BB)
+          instTypes[&I] = this->moduleInfo->getInstType(I);
+      diagnose = !DiagnosticsFile.empty() && diagnostics->matchesFunction(F.getName());
+    }
 
-      firstTime = OUT.find(BB.getTerminator()) == OUT.end();
+    // sets for RDA
+    RDAMap IN, OUT;
+    AliasClassMap aliIN, aliOUT;
+    AliasMap ptIN, ptOUT;
+    // the CAT types inferred in the function, the globals not inferred have their module types
+    DenseMap<Value *, VType> catTypes;
+    DenseMap<Instruction *, Instruction *> deleteMap;
+    DenseMap<Value *, Value *> propMap;
+    // the definitions dead code elimination erased, which may still be in the facts of the definitions left
+    SmallPtrSet<Instruction *, 16> erasedDefs;
+    // the instructions that asked whether a definition is constant
+    DenseMap<Instruction *, SmallVector<CallInst *, 4>> defQueries;
 
-      for (auto &pair : OUT[BB.getTerminator()])
-        for (auto *I : pair.second)
-          oldOut.insert(I);
+    // state of the block engine, reserved for every block of the function before the fixed point so that the references
+    // to the facts of a block stay valid while the facts of the others are created
+    DenseMap<BasicBlock *, BlockFacts> blockFacts;
+    SmallPtrSet<BasicBlock *, 16> mapVisited;
 
-      // merge the predecessors' information
-      if (!predecessors(&BB).empty())
-        for (auto *PB : predecessors(&BB))
-        {
-          for (auto &pair : OUT[PB->getTerminator()])
-            for (auto *I : pair.second)
-              curIN[pair.first].insert(I);
+    // memoized findAllPossibleCATData of the program point being analyzed
+    DenseMap<Value *, ValueSet> closureCache;
+    DenseMap<Value *, SmallVector<Value *, 4>> closureDependents;
+    DefUseGraph useGraph;
+    DenseMap<Value *, unsigned> valueIndex;
+    DenseMap<Instruction *, unsigned> defIndex;
+    std::vector<Instruction *> defList;
 
-          for (auto &pair : aliOUT[PB->getTerminator()])
-            for (auto *I : pair.second)
-              curAliIN[pair.first].insert(I);
+    // the summaries of the calls to non-CAT functions
+    DenseMap<CallInst *, CallSiteSummary> callSummaries;
 
-          for (auto &pair : ptOUT[PB->getTerminator()])
-            for (auto *I : pair.second)
-              curPtIN[pair.first].insert(I);
-        }
-      else
+    Function *curFunc;
+    Module *curModule;
+    // only read while the call sites are summarized, which copies what they need
+    const FunctionSummaryMap *funcSummaries;
+    std::shared_ptr<const ModuleInfo> moduleInfo;
+    // the classification of each instruction, the instructions created by folding are added when they are first seen
+    DenseMap<Instruction *, InstType> instTypes;
+
+    // only available while the function is analyzed or transformed on the thread of the pass
+    AliasAnalysis *AA = nullptr;
+
+    // whether the folding of this function is diagnosed, and the numbers of its instructions when the folding started
+    // each round of the loop transformations folds the function again with a new context, and numbers it again
+    bool diagnose = false;
+    unsigned diagRound = 0;
+    DenseMap<Instruction *, unsigned> diagNumbers;
+
+    // the messages of the analysis, printed in the order of the functions
+    std::string messages;
+    raw_string_ostream log{messages};
+
+    int getSize(Value *ptr)
+    {
+      auto *ptrType = cast<PointerType>(ptr->getType())->getPointerElementType();
+      return ptrType->isSized() ? curModule->getDataLayout().getTypeStoreSize(ptrType) : 0;
+    }
+
+    bool mayModifiedByFunc(CallInst *callInst, Value *ptr)
+    {
+      switch (AA->getModRefInfo(callInst, ptr, getSize(ptr)))
       {
-        // if the block has no predecessors, then it's the entry block
-        // entry block will only be entered once at the beginning of the analysis
-        // initialize the RDA for arguments and globals
-        for (auto &arg : BB.getParent()->args())
-          switch (checkType(&arg))
-          {
-          case CAT_DATA:
-            curIN[&arg].insert(UNKNOWN);
-            break;
-          case CAT_PTR:
-            curPtIN[&arg].insert(UNKNOWN);
-            break;
-          case OTHER:
-            break;
-          }
+      case ModRefInfo::Mod:
+      case ModRefInfo::ModRef:
+      case ModRefInfo::MustMod:
+        return true;
+      default:
+        return false;
+      }
+    }
 
-        for (auto &GV : curModule->globals())
-          switch (checkType(&GV))
-          {
-          case CAT_DATA:
-            curIN[&GV].insert(UNKNOWN);
-            break;
-          case CAT_PTR:
-            curPtIN[&GV].insert(UNKNOWN);
-            break;
-          case OTHER:
-            break;
-          }
+    bool mayReferencedByFunc(CallInst *callInst, Value *ptr)
+    {
+      switch (AA->getModRefInfo(callInst, ptr, getSize(ptr)))
+      {
+      case ModRefInfo::Ref:
+      case ModRefInfo::ModRef:
+      case ModRefInfo::MustRef:
+        return true;
+      default:
+        return false;
+      }
+    }
 
-        // initialize the alias information
-        for (Value *v : allCATData)
-          curAliIN[v].insert(v);
-        for (Value *v : allCATPtr)
-          curAliIN[v].insert(v);
+    // summarize a call site the first time it's analyzed
+    CallSiteSummary &getCallSummary(CallInst *callInst)
+    {
+      auto it = callSummaries.find(callInst);
+      if (it != callSummaries.end())
+        return it->second;
+
+      auto &summary = callSummaries[callInst];
+      auto passIn = [&](Value *v)
+      {
+        switch (checkType(v))
+        {
+        case CAT_DATA:
+          summary.dataPassedIn.insert(v);
+          break;
+        case CAT_PTR:
+          if (summary.ptrPassedIn.insert(v) && mayReferencedByFunc(callInst, v))
+            summary.ptrReferenced.push_back(v);
+          break;
+        case OTHER:
+          break;
+        }
+      };
+
+      for (auto *GV : moduleInfo->catGlobals)
+        passIn(GV);
+      for (unsigned i = 0; i < callInst->getNumOperands() - 1; i++)
+        passIn(callInst->getArgOperand(i));
+
+      for (auto *ptr : summary.ptrPassedIn)
+        if (mayModifiedByFunc(callInst, ptr))
+          summary.ptrModified.insert(ptr);
+
+      if (auto *funcSummary = getFunctionSummary(callInst->getCalledFunction()))
+        summary.summarized = applyFunctionSummary(*funcSummary, callInst, summary);
+      return summary;
+    }
+
+    // translate the summary of the callee to the values of the caller
+    // it doesn't apply if the caller doesn't see them as CAT data
+    bool applyFunctionSummary(const FunctionSummary &funcSummary, CallInst *callInst, CallSiteSummary &summary)
+    {
+      if (checkType(callInst) == CAT_PTR)
+        return false;
+
+      for (auto i : funcSummary.modifiedArgs)
+        summary.killedData.push_back(callInst->getArgOperand(i));
+      summary.killedData.insert(summary.killedData.end(), funcSummary.modifiedGlobals.begin(), funcSummary.modifiedGlobals.end());
+
+      if (checkType(callInst) == CAT_DATA)
+      {
+        for (auto i : funcSummary.returnedArgs)
+          summary.returnedData.push_back(callInst->getArgOperand(i));
+        summary.returnedData.insert(summary.returnedData.end(), funcSummary.returnedGlobals.begin(), funcSummary.returnedGlobals.end());
+        summary.returnsFresh = funcSummary.returnsFresh;
+        summary.returnConstant = funcSummary.returnConstant;
       }
 
-      // calculate IN and OUT for each instruction in the current block
-      for (auto &I : BB)
+      for (auto *data : summary.killedData)
+        if (checkType(data) != CAT_DATA)
+          return false;
+      for (auto *data : summary.returnedData)
+        if (checkType(data) != CAT_DATA)
+          return false;
+      return true;
+    }
+
+    const FunctionSummary *getFunctionSummary(Function *F)
+    {
+      return funcSummaries ? findFunctionSummary(*funcSummaries, F) : nullptr;
+    }
+
+    bool isDataModifiedByCall(CallSiteSummary &summary, CallInst *callInst, Value *data)
+    {
+      auto it = summary.dataModified.try_emplace(data, true);
+      // without alias analysis, the data may be modified
+      if (it.second && AA)
+        it.first->second = mayModifiedByFunc(callInst, data);
+      return it.first->second;
+    }
+
+    bool mayAliasReturn(CallSiteSummary &summary, CallInst *callInst, Value *v)
+    {
+      auto it = summary.aliasesReturn.try_emplace(v, true);
+      // without alias analysis, the return value may alias anything
+      if (it.second && AA)
+        it.first->second = AA->alias(v, getSize(v), callInst, getSize(callInst)) != AliasResult::NoAlias;
+      return it.first->second;
+    }
+
+    // answer the alias queries the fixed point may ask at the calls, so it can run without alias analysis
+    void precomputeCallQueries()
+    {
+      for (auto &pair : callSummaries)
       {
-        auto type = getInstType(I);
-        if (type == IGNORED && &I != BB.getTerminator())
+        auto *callInst = pair.first;
+        auto &summary = pair.second;
+        if (summary.summarized)
           continue;
+        bool returnsData = checkType(callInst) == CAT_DATA;
+        forEachCATValue([&](Value *v, VType type)
+                        {
+                          if (type != CAT_DATA)
+                            return;
+                          isDataModifiedByCall(summary, callInst, v);
+                          if (returnsData)
+                            mayAliasReturn(summary, callInst, v); });
+        if (!returnsData && checkType(callInst) == CAT_PTR)
+          for (auto *ptr : summary.ptrPassedIn)
+            mayAliasReturn(summary, callInst, ptr);
+      }
+    }
 
-        IN[&I] = curIN;
-        curOUT = curIN;
-        aliIN[&I] = curAliIN;
-        curAliOUT = curAliIN;
-        ptIN[&I] = curPtIN;
-        curPtOUT = curPtIN;
+    // summarize all the calls to non-CAT functions before the fixed point
+    void summarizeCallSites()
+    {
+      unsigned calls = 0;
+      for (auto &BB : *curFunc)
+        calls += llvm::count_if(BB, [&](Instruction &I)
+                                { return getInstType(I) == MISC_FUNC; });
+      callSummaries.reserve(calls);
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+          if (getInstType(I) == MISC_FUNC)
+            getCallSummary(cast<CallInst>(&I));
+    }
 
-        if (type == PHI)
-        {
-          auto *phiNode = cast<PHINode>(&I);
-          // reset its alias info
-          resetAliasInfo(phiNode, curAliIN, curAliOUT);
-          // merge alias info
-          int n = phiNode->getNumIncomingValues();
-          for (int i = 0; i < n; i++)
-          {
-            auto *predBB = phiNode->getIncomingBlock(i);
-            auto *incomingVal = phiNode->getIncomingValue(i);
-            // merge the aliasing information
-            for (auto *alias : aliOUT[predBB->getTerminator()][incomingVal])
-            {
-              curAliOUT[phiNode].insert(alias);
-              curAliOUT[alias].insert(phiNode);
-            }
-          }
+    void mergeAliasInfo(Value *source, Value *target, AliasClasses &curAliIN, AliasClasses &curAliOUT)
+    {
+      curAliOUT.join(target, source, curAliIN);
+    }
 
-          switch (checkType(phiNode))
-          {
-          case CAT_DATA:
-            // clear the RDA set
-            curOUT[phiNode].clear();
-            // merge RDA info
-            for (int i = 0; i < n; i++)
-            {
-              auto *predBB = phiNode->getIncomingBlock(i);
-              auto *incomingVal = phiNode->getIncomingValue(i);
-              auto predRDA = OUT[predBB->getTerminator()][incomingVal];
-              curOUT[phiNode].insert(predRDA.begin(), predRDA.end());
-            }
-            break;
-          case CAT_PTR:
-            // clear the point-to set
-            curPtOUT[phiNode].clear();
-            // merge point-to info
-            for (int i = 0; i < n; i++)
-            {
-              auto *predBB = phiNode->getIncomingBlock(i);
-              auto *incomingVal = phiNode->getIncomingValue(i);
-              auto predPt = ptOUT[predBB->getTerminator()][incomingVal];
-              curPtOUT[phiNode].insert(predPt.begin(), predPt.end());
-            }
-            break;
-          case OTHER:
-            break;
-          }
-        }
-        else if (type == SELECT)
-        {
-          auto *selectInst = cast<SelectInst>(&I);
-          auto *op1 = selectInst->getOperand(1), *op2 = selectInst->getOperand(2);
+    InstType getInstType(Instruction &I)
+    {
+      auto it = instTypes.find(&I);
+      if (it != instTypes.end())
+        return it->second;
+      return instTypes[&I] = moduleInfo->getInstType(I);
+    }
+
+    CATApi getApi(CallInst *callInst) const
+    {
+      return moduleInfo->getApi(callInst);
+    }
+
+    // the declaration of a CAT API in the module, or null if the module doesn't declare it
+    Function *getApiDecl(CATApi api) const
+    {
+      return moduleInfo->apiDecls[api];
+    }
+
+    VType checkType(Value *v)
+    {
+      auto it = catTypes.find(v);
+      if (it != catTypes.end())
+        return it->second;
+      if (isa<GlobalVariable>(v))
+      {
+        auto git = moduleInfo->globalTypes.find(v);
+        if (git != moduleInfo->globalTypes.end())
+          return git->second;
+      }
+      return OTHER;
+    }
+
+    // call f on every value of CAT type, the globals included
+    void forEachCATValue(function_ref<void(Value *, VType)> f)
+    {
+      for (auto &pair : catTypes)
+        f(pair.first, pair.second);
+      for (auto *GV : moduleInfo->catGlobals)
+        if (!catTypes.count(GV))
+          f(GV, moduleInfo->globalTypes.find(GV)->second);
+    }
+
+    void resetAliasInfo(Value *v, AliasClasses &curAliOUT)
+    {
+      curAliOUT.reset(v);
+    }
+
+    unsigned getValueIndex(Value *v)
+    {
+      auto it = valueIndex.find(v);
+      if (it != valueIndex.end())
+        return it->second;
+      unsigned idx = valueIndex.size();
+      valueIndex[v] = idx;
+      return idx;
+    }
+
+    // definitions are numbered densely on their first appearance
+    unsigned getDefIndex(Instruction *def)
+    {
+      if (def == UNKNOWN)
+        return 0;
+      auto it = defIndex.find(def);
+      if (it != defIndex.end())
+        return it->second;
+      defIndex[def] = defList.size();
+      defList.push_back(def);
+      return defList.size() - 1;
+    }
+
+    DefSet &getDefSet(BlockRDASet &rda, Value *v)
+    {
+      auto idx = getValueIndex(v);
+      if (idx >= rda.defs.size())
+        rda.defs.resize(idx + 1);
+      return rda.defs[idx];
+    }
+
+    // primitive operations on the RDA facts, one overload per engine
+    void clearDefs(RDASet &rda, Value *v) { rda[v].clear(); }
+    void clearDefs(BlockRDASet &rda, Value *v) { getDefSet(rda, v).clear(); }
+
+    void insertDef(RDASet &rda, Value *v, Instruction *def) { rda[v].insert(def); }
+    void insertDef(BlockRDASet &rda, Value *v, Instruction *def) { getDefSet(rda, v).insert(getDefIndex(def)); }
+
+    // add the definitions of u in src to the definitions of v in dst
+    void unionDefs(RDASet &dst, Value *v, RDASet &src, Value *u)
+    {
+      auto &srcDefs = src[u];
+      dst[v].insert(srcDefs.begin(), srcDefs.end());
+    }
+
+    void unionDefs(BlockRDASet &dst, Value *v, BlockRDASet &src, Value *u)
+    {
+      // dst and src may be the same set, so resize before taking any reference
+      auto &dstDefs = getDefSet(dst, v);
+      auto srcIdx = getValueIndex(u);
+      if (srcIdx < src.defs.size())
+        dstDefs |= src.defs[srcIdx];
+    }
+
+    // the merges return true if dst grows
+    bool mergeDefs(RDASet &dst, RDASet &src)
+    {
+      bool changed = false;
+      for (auto &pair : src)
+      {
+        auto &defs = dst[pair.first];
+        auto oldSize = defs.size();
+        defs.insert(pair.second.begin(), pair.second.end());
+        changed |= defs.size() != oldSize;
+      }
+      return changed;
+    }
+
+    bool mergeDefs(BlockRDASet &dst, BlockRDASet &src)
+    {
+      bool changed = false;
+      if (dst.defs.size() < src.defs.size())
+        dst.defs.resize(src.defs.size());
+      for (size_t i = 0; i < src.defs.size(); i++)
+        changed |= dst.defs[i] |= src.defs[i];
+      return changed;
+    }
+
+    bool mergeAliases(AliasSet &dst, AliasSet &src)
+    {
+      bool changed = false;
+      for (auto &pair : src)
+        changed |= dst[pair.first].unite(pair.second);
+      return changed;
+    }
+
+    template <typename S>
+    void addDef(Value *v, Instruction *def, AliasClasses &aliases, S &curOUT)
+    {
+      if (!aliases.contains(v))
+      {
+        log << "[WARNING] " << *v << " alias not init!\n";
+        aliases.add(v);
+      }
+
+      aliases.forEachAlias(v, [&](Value *alias)
+                           { insertDef(curOUT, alias, def); });
+    }
+
+    template <typename S>
+    void setDef(Value *v, Instruction *def, AliasClasses &aliases, S &curOUT)
+    {
+      clearDefs(curOUT, v);
+      addDef(v, def, aliases, curOUT);
+    }
+
+    void addPointTo(Value *ptr, Value *val, AliasClasses &aliases, AliasSet &curPtOUT)
+    {
+      if (!aliases.contains(ptr))
+      {
+        log << "[WARNING] " << *ptr << " alias not init!\n";
+        aliases.add(ptr);
+      }
+
+      aliases.forEachAlias(ptr, [&](Value *alias)
+                           {
+                             curPtOUT[alias].insert(val);
+                             invalidateClosure(alias); });
+    }
+
+    void setPointTo(Value *ptr, Value *val, AliasClasses &aliases, AliasSet &curPtOUT)
+    {
+      clearPointTo(ptr, curPtOUT);
+      addPointTo(ptr, val, aliases, curPtOUT);
+    }
+
+    void clearPointTo(Value *ptr, AliasSet &curPtOUT)
+    {
+      curPtOUT[ptr].clear();
+      invalidateClosure(ptr);
+    }
+
+    // drop the memoized closures that went through ptr, because what ptr points to changes
+    void invalidateClosure(Value *ptr)
+    {
+      auto it = closureDependents.find(ptr);
+      if (it == closureDependents.end())
+        return;
+      for (auto *root : it->second)
+        closureCache.erase(root);
+      closureDependents.erase(it);
+    }
+
+    // all the CAT data that may be reached from ptr through chains of CAT_PTR
+    // the result is memoized for the current program point, and pointer cycles are visited once
+    // the reference is valid until the next call
+    const ValueSet &findAllPossibleCATData(Value *ptr, AliasSet &curPtIN)
+    {
+      auto cached = closureCache.find(ptr);
+      if (cached != closureCache.end())
+        return cached->second;
+
+      ValueSet possibleCATData;
+      SmallPtrSet<Value *, 16> visited;
+      SmallVector<Value *, 16> toVisit = {ptr};
+      visited.insert(ptr);
+      while (!toVisit.empty())
+      {
+        auto *cur = toVisit.pop_back_val();
+        closureDependents[cur].push_back(ptr);
+        for (auto *pointed : curPtIN.lookup(cur))
+        {
+          if (pointed == UNKNOWN)
+          {
+            possibleCATData.insert(UNKNOWN);
+            continue;
+          }
+
+          switch (checkType(pointed))
+          {
+          case CAT_DATA:
+            possibleCATData.insert(pointed);
+            break;
+          case OTHER:
+            break;
+          case CAT_PTR:
+            if (visited.insert(pointed).second)
+              toVisit.push_back(pointed);
+            break;
+          }
+        }
+      }
+
+      return closureCache[ptr] = std::move(possibleCATData);
+    }
+
+    // infer the CAT types from the CAT calls, then propagate them along the uses and definitions
+    // a value only goes from OTHER to CAT_PTR to CAT_DATA, so it enters the worklist at most twice
+    void collectTypeInfo()
+    {
+      auto timer = timePhase(&PhaseTimers::typeInfo);
+      unsigned visits = 0;
+      SmallVector<Value *, 64> worklist;
+      auto raise = [&](Value *v, VType type)
+      {
+        auto it = catTypes.try_emplace(v, type);
+        if (!it.second)
+        {
+          // CAT data wins over CAT pointer
+          if (it.first->second == CAT_DATA || type != CAT_DATA)
+            return;
+          it.first->second = CAT_DATA;
+        }
+        worklist.push_back(v);
+      };
+
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+        {
+          if (isa<AllocaInst>(&I))
+            raise(&I, CAT_PTR);
+          else if (auto *callInst = dyn_cast<CallInst>(&I))
+            switch (getApi(callInst))
+            {
+            case API_NEW:
+              raise(callInst, CAT_DATA);
+              break;
+            case API_GET:
+            case API_SET:
+            case API_DESTROY:
+              raise(callInst->getArgOperand(0), CAT_DATA);
+              break;
+            case API_ADD:
+            case API_SUB:
+              for (unsigned i = 0; i < 3; i++)
+                raise(callInst->getArgOperand(i), CAT_DATA);
+              break;
+            default:
+              break;
+            }
+        }
+
+      while (!worklist.empty())
+      {
+        auto *v = worklist.pop_back_val();
+        auto type = catTypes[v];
+        visits++;
+
+        // the values merged by a PHI or a select have its type
+        if (auto *phiNode = dyn_cast<PHINode>(v))
+          for (auto &incoming : phiNode->incoming_values())
+            raise(incoming, type);
+        else if (auto *selectInst = dyn_cast<SelectInst>(v))
+        {
+          raise(selectInst->getTrueValue(), type);
+          raise(selectInst->getFalseValue(), type);
+        }
+        // a CAT value is loaded from a CAT pointer
+        else if (auto *loadInst = dyn_cast<LoadInst>(v))
+          raise(loadInst->getPointerOperand(), CAT_PTR);
+
+        // constants like null are shared by the whole module, their types don't tell about their users
+        if (isa<ConstantData>(v))
+          continue;
+        for (auto &U : v->uses())
+        {
+          auto *user = dyn_cast<Instruction>(U.getUser());
+          if (!user || user->getFunction() != curFunc)
+            continue;
+          if (isa<PHINode>(user) || (isa<SelectInst>(user) && U.getOperandNo() != 0))
+            raise(user, type);
+          // a CAT value is stored to a CAT pointer
+          else if (auto *storeInst = dyn_cast<StoreInst>(user))
+            if (U.getOperandNo() == 0)
+              raise(storeInst->getPointerOperand(), CAT_PTR);
+        }
+      }
+
+      // the pointers the uses don't tell about are sorted by the type they point to
+      sweepTypeInfo();
+      NumTypeVisits += visits;
+    }
+
+    void sortAccordingToType(Value *v)
+    {
+      if (!v->getType()->isPointerTy() || checkType(v) != OTHER)
+        return;
+      auto *ptrType = cast<PointerType>(v->getType());
+      catTypes[v] = ptrType->getPointerElementType()->isIntegerTy(8) ? CAT_DATA : CAT_PTR;
+    }
+
+    void sweepTypeInfo()
+    {
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+        {
+          if (auto *allocaInst = dyn_cast<AllocaInst>(&I))
+            sortAccordingToType(allocaInst);
+          else if (auto *phiNode = dyn_cast<PHINode>(&I))
+            sortAccordingToType(phiNode);
+          else if (auto *selectInst = dyn_cast<SelectInst>(&I))
+            sortAccordingToType(selectInst);
+          else if (auto *storeInst = dyn_cast<StoreInst>(&I))
+          {
+            sortAccordingToType(storeInst->getPointerOperand());
+            sortAccordingToType(storeInst->getValueOperand());
+          }
+          else if (auto *loadInst = dyn_cast<LoadInst>(&I))
+          {
+            sortAccordingToType(loadInst->getPointerOperand());
+            sortAccordingToType(loadInst);
+          }
+          else if (auto *bitcastInst = dyn_cast<BitCastInst>(&I))
+          {
+            sortAccordingToType(bitcastInst);
+            sortAccordingToType(bitcastInst->getOperand(0));
+          }
+          else if (auto *callInst = dyn_cast<CallInst>(&I))
+            sortAccordingToType(callInst);
+        }
+    }
+
+    // RDA facts at the exit of a block, for either engine
+    template <typename S>
+    S &blockRDAOut(BasicBlock *BB)
+    {
+      if constexpr (std::is_same_v<S, RDASet>)
+        return OUT[BB->getTerminator()];
+      else
+        return blockFacts[BB].rdaOUT;
+    }
+
+    template <typename S>
+    AliasClasses &blockAliOut(BasicBlock *BB)
+    {
+      if constexpr (std::is_same_v<S, RDASet>)
+        return aliOUT[BB->getTerminator()];
+      else
+        return blockFacts[BB].aliOUT;
+    }
+
+    template <typename S>
+    AliasSet &blockPtOut(BasicBlock *BB)
+    {
+      if constexpr (std::is_same_v<S, RDASet>)
+        return ptOUT[BB->getTerminator()];
+      else
+        return blockFacts[BB].ptOUT;
+    }
+
+    // compute the facts at the entry of a block
+    template <typename S>
+    void initBlockEntry(BasicBlock &BB, S &curIN, AliasClasses &curAliIN, AliasSet &curPtIN)
+    {
+      // merge the predecessors' information
+      if (!predecessors(&BB).empty())
+        for (auto *PB : predecessors(&BB))
+        {
+          mergeDefs(curIN, blockRDAOut<S>(PB));
+          curAliIN.merge(blockAliOut<S>(PB));
+          mergeAliases(curPtIN, blockPtOut<S>(PB));
+        }
+      else
+      {
+        // if the block has no predecessors, then it's the entry block
+        // entry block will only be entered once at the beginning of the analysis
+        // initialize the RDA for arguments and globals
+        for (auto &arg : BB.getParent()->args())
+          switch (checkType(&arg))
+          {
+          case CAT_DATA:
+            insertDef(curIN, &arg, UNKNOWN);
+            break;
+          case CAT_PTR:
+            curPtIN[&arg].insert(UNKNOWN);
+            break;
+          case OTHER:
+            break;
+          }
+
+        for (auto *GV : moduleInfo->catGlobals)
+          if (checkType(GV) == CAT_DATA)
+            insertDef(curIN, GV, UNKNOWN);
+          else
+            curPtIN[GV].insert(UNKNOWN);
+
+        // initialize the alias information
+        forEachCATValue([&](Value *v, VType)
+                        { curAliIN.add(v); });
+      }
+    }
+
+    // apply the transfer function of the whole block, starting from the facts at its entry
+    // on return, the current sets hold the facts at the exit of the block
+    // record is invoked with the facts before (isOut = false) and after (isOut = true) each analyzed instruction
+    template <typename S>
+    void transferBB(BasicBlock &BB, S &curIN, AliasClasses &curAliIN, AliasSet &curPtIN,
+                    function_ref<void(Instruction &, S &, AliasClasses &, AliasSet &, bool)> record = nullptr)
+    {
+      S curOUT;
+      AliasClasses curAliOUT;
+      AliasSet curPtOUT;
+
+      // the memoized closures belong to the facts of another program point
+      closureCache.clear();
+      closureDependents.clear();
+
+      // calculate IN and OUT for each instruction in the current block
+      for (auto &I : BB)
+      {
+        auto type = getInstType(I);
+        if (type == IGNORED && &I != BB.getTerminator())
+          continue;
+
+        if (record)
+          record(I, curIN, curAliIN, curPtIN, false);
+        curOUT = curIN;
+        curAliOUT = curAliIN;
+        curPtOUT = curPtIN;
+
+        transferInst(I, type, curIN, curOUT, curAliIN, curAliOUT, curPtIN, curPtOUT);
+
+        if (record)
+          record(I, curOUT, curAliOUT, curPtOUT, true);
+        curIN = std::move(curOUT);
+        curAliIN = std::move(curAliOUT);
+        curPtIN = std::move(curPtOUT);
+      }
+    }
+
+    template <typename S>
+    void transferInst(Instruction &I, InstType type, S &curIN, S &curOUT, AliasClasses &curAliIN, AliasClasses &curAliOUT, AliasSet &curPtIN, AliasSet &curPtOUT)
+    {
+      if (type == PHI)
+      {
+        auto *phiNode = cast<PHINode>(&I);
+        // reset its alias info
+        resetAliasInfo(phiNode, curAliOUT);
+        // merge alias info
+        int n = phiNode->getNumIncomingValues();
+        for (int i = 0; i < n; i++)
+        {
+          auto *predBB = phiNode->getIncomingBlock(i);
+          auto *incomingVal = phiNode->getIncomingValue(i);
+          // merge the aliasing information
+          curAliOUT.join(phiNode, incomingVal, blockAliOut<S>(predBB));
+        }
+
+        switch (checkType(phiNode))
+        {
+        case CAT_DATA:
+          // clear the RDA set
+          clearDefs(curOUT, phiNode);
+          // merge RDA info
+          for (int i = 0; i < n; i++)
+          {
+            auto *predBB = phiNode->getIncomingBlock(i);
+            auto *incomingVal = phiNode->getIncomingValue(i);
+            unionDefs(curOUT, phiNode, blockRDAOut<S>(predBB), incomingVal);
+          }
+          break;
+        case CAT_PTR:
+          // clear the point-to set
+          clearPointTo(phiNode, curPtOUT);
+          // merge point-to info
+          for (int i = 0; i < n; i++)
+          {
+            auto *predBB = phiNode->getIncomingBlock(i);
+            auto *incomingVal = phiNode->getIncomingValue(i);
+            curPtOUT[phiNode].unite(blockPtOut<S>(predBB).lookup(incomingVal));
+          }
+          break;
+        case OTHER:
+          break;
+        }
+      }
+      else if (type == SELECT)
+      {
+        auto *selectInst = cast<SelectInst>(&I);
+        auto *op1 = selectInst->getOperand(1), *op2 = selectInst->getOperand(2);
+
+        resetAliasInfo(selectInst, curAliOUT);
+        for (auto *op : {op1, op2})
+          mergeAliasInfo(op, selectInst, curAliIN, curAliOUT);
+
+        switch (checkType(selectInst))
+        {
+        case CAT_DATA:
+          clearDefs(curOUT, selectInst);
+          for (auto *op : {op1, op2})
+            unionDefs(curOUT, selectInst, curIN, op);
+          break;
+        case CAT_PTR:
+          clearPointTo(selectInst, curPtOUT);
+          for (auto *op : {op1, op2})
+            curPtOUT[selectInst].unite(curPtIN.lookup(op));
+          break;
+        case OTHER:
+          break;
+        }
+      }
+      else if (type == ALLOCA)
+      {
+        auto *allocaInst = cast<AllocaInst>(&I);
+        if (checkType(allocaInst) == CAT_PTR)
+        {
+          resetAliasInfo(allocaInst, curAliOUT);
+          clearPointTo(allocaInst, curPtOUT);
+        }
+        else
+          log << "[WARNING] In " << *allocaInst << " the ptr is not recognized\n";
+      }
+      else if (type == STORE)
+      {
+        auto *storeInst = cast<StoreInst>(&I);
+        auto *ptr = storeInst->getPointerOperand();
+        auto *value = storeInst->getValueOperand();
+        if (checkType(ptr) == CAT_PTR)
+          setPointTo(ptr, value, curAliIN, curPtOUT);
+        else
+          log << "[WARNING] In " << *storeInst << " the ptr is not recognized\n";
+      }
+      else if (type == LOAD)
+      {
+        auto *loadInst = cast<LoadInst>(&I);
+        auto *ptr = loadInst->getPointerOperand();
+
+        if (checkType(ptr) == CAT_PTR)
+        {
+          // reset for loaded value
+          resetAliasInfo(loadInst, curAliOUT);
+          for (auto *pointed : curPtIN.lookup(ptr))
+          {
+            if (pointed == UNKNOWN)
+              continue;
+            mergeAliasInfo(pointed, loadInst, curAliIN, curAliOUT);
+          }
+
+          switch (checkType(loadInst))
+          {
+          case CAT_DATA:
+            clearDefs(curOUT, loadInst);
+            for (auto *pointed : curPtIN.lookup(ptr))
+              if (pointed == UNKNOWN)
+                insertDef(curOUT, loadInst, UNKNOWN);
+              else if (checkType(pointed) != CAT_DATA)
+                log << "[WARNING] In " << *loadInst << " trying to assign invalid type to DATA\n";
+              else
+                unionDefs(curOUT, loadInst, curIN, pointed);
+            break;
+          case CAT_PTR:
+            clearPointTo(loadInst, curPtOUT);
+            for (auto *pointed : curPtIN.lookup(ptr))
+              if (pointed == UNKNOWN)
+                curPtOUT[loadInst].insert(UNKNOWN);
+              else if (checkType(pointed) != CAT_PTR)
+                log << "[WARNING] In " << *loadInst << " trying to assign invalid type to PTR\n";
+              else
+                curPtOUT[loadInst].unite(curPtIN.lookup(pointed));
+            break;
+          case OTHER:
+            break;
+          }
+          // if previously there is only UNKNOWN in curPtIN, then delegate the UNKNOWN to loaded value
+          curPtOUT[ptr].erase(UNKNOWN);
+          invalidateClosure(ptr);
+          // add a new relationship
+          addPointTo(ptr, loadInst, curAliIN, curPtOUT);
+        }
+        else
+          log << "[WARNING] In " << *loadInst << " the ptr is not recognized\n";
+      }
+      else if (type == BITCAST)
+      {
+        auto *bitcastInst = cast<BitCastInst>(&I);
+        auto *casted = bitcastInst->getOperand(0);
+        resetAliasInfo(bitcastInst, curAliOUT);
+        mergeAliasInfo(casted, bitcastInst, curAliIN, curAliOUT);
+        switch (checkType(bitcastInst))
+        {
+        case CAT_DATA:
+          clearDefs(curOUT, bitcastInst);
+          unionDefs(curOUT, bitcastInst, curIN, casted);
+          break;
+        case CAT_PTR:
+          clearPointTo(bitcastInst, curPtOUT);
+          curPtOUT[bitcastInst].unite(curPtIN.lookup(casted));
+          break;
+        case OTHER:
+          break;
+        }
+      }
+      else if (type == CAT_NEW)
+      {
+        auto *newInst = cast<CallInst>(&I);
+        // reset the aliasing information
+        resetAliasInfo(newInst, curAliOUT);
+        setDef(newInst, newInst, curAliOUT, curOUT);
+      }
+      else if (type == CAT_MOD)
+      {
+        auto *modInst = cast<CallInst>(&I);
+        Value *gen = modInst->getArgOperand(0);
+        setDef(gen, modInst, curAliOUT, curOUT);
+      }
+      else if (type == MISC_FUNC)
+      {
+        auto *callInst = cast<CallInst>(&I);
+        auto &summary = getCallSummary(callInst);
+        if (summary.summarized)
+        {
+          for (auto *data : summary.killedData)
+            setDef(data, UNKNOWN, curAliIN, curOUT);
+          if (checkType(callInst) == CAT_DATA)
+          {
+            resetAliasInfo(callInst, curAliOUT);
+            clearDefs(curOUT, callInst);
+            // created data is defined by the call itself
+            if (summary.returnsFresh)
+              insertDef(curOUT, callInst, callInst);
+            for (auto *data : summary.returnedData)
+            {
+              unionDefs(curOUT, callInst, curOUT, data);
+              mergeAliasInfo(data, callInst, curAliIN, curAliOUT);
+            }
+          }
+          return;
+        }
+
+        auto &possiblePtrPassedIn = summary.ptrPassedIn;
+        auto &possiblePtrModified = summary.ptrModified;
+        ValueSet possibleDataPassedIn = summary.dataPassedIn;
+
+        // the data pointed by the referenced pointers is passed in too
+        for (auto *ptr : summary.ptrReferenced)
+        {
+          possibleDataPassedIn.unite(findAllPossibleCATData(ptr, curPtIN));
+        }
+
+        for (auto *data : possibleDataPassedIn)
+          if (data == UNKNOWN)
+            continue;
+          else if (isDataModifiedByCall(summary, callInst, data))
+            setDef(data, UNKNOWN, curAliIN, curOUT);
+
+        // modified PTR can point to any passed in DATA
+        for (auto *ptr : possiblePtrModified)
+          for (auto *data : possibleDataPassedIn)
+            addPointTo(ptr, data, curAliIN, curPtOUT);
+
+        // the return value can be alias of any same-level argument
+        switch (checkType(callInst))
+        {
+        case CAT_DATA:
+          // merge all info of possible CAT_data
+          resetAliasInfo(callInst, curAliOUT);
+          clearDefs(curOUT, callInst);
+
+          // it could be pointed by any possible CAT_ptr modified
+          for (auto *ptr : possiblePtrModified)
+          {
+            curPtOUT[ptr].insert(callInst);
+            invalidateClosure(ptr);
+          }
+
+          for (auto *data : possibleDataPassedIn)
+          {
+            if (data == UNKNOWN)
+              insertDef(curOUT, callInst, UNKNOWN);
+            else if (!mayAliasReturn(summary, callInst, data))
+              continue;
+            else
+            {
+              unionDefs(curOUT, callInst, curOUT, data);
+              mergeAliasInfo(data, callInst, curAliIN, curAliOUT);
+            }
+          }
+          break;
+        case CAT_PTR:
+          // merge all info of possible CAT_ptr
+          resetAliasInfo(callInst, curAliOUT);
+          clearPointTo(callInst, curPtOUT);
+          for (auto *ptr : possiblePtrPassedIn)
+          {
+            if (!mayAliasReturn(summary, callInst, ptr))
+              continue;
+            // copied, as adding the set of callInst may move the one of ptr
+            auto pointed = curPtOUT.lookup(ptr);
+            curPtOUT[callInst].unite(pointed);
+            mergeAliasInfo(ptr, callInst, curAliIN, curAliOUT);
+          }
+          break;
+        case OTHER:
+          break;
+        }
+      }
+    }
+
+    // analyze a block, and accumulate the facts at its exit
+    // the map-based engine records the facts of every instruction, the block engine only the facts at the block exit
+    // kills go through alias sets that change between iterations, so the transfer is not monotone
+    // accumulating into the exit facts keeps them sound and guarantees termination,
+    // and whether the block changed is known from the merge itself, without comparing the old and new facts
+    template <typename S>
+    bool RDAinBB(BasicBlock &BB)
+    {
+      S curIN;
+      AliasClasses curAliIN;
+      AliasSet curPtIN;
+      bool firstTime;
+
+      initBlockEntry(BB, curIN, curAliIN, curPtIN);
+
+      if constexpr (std::is_same_v<S, RDASet>)
+      {
+        firstTime = mapVisited.insert(&BB).second;
+        transferBB<RDASet>(BB, curIN, curAliIN, curPtIN, [&](Instruction &I, RDASet &rda, AliasClasses &ali, AliasSet &pt, bool isOut)
+                           {
+                             // the exit facts of the block are accumulated below
+                             if (isOut && &I == BB.getTerminator())
+                               return;
+                             (isOut ? OUT : IN)[&I] = rda;
+                             (isOut ? aliOUT : aliIN)[&I] = ali;
+                             (isOut ? ptOUT : ptIN)[&I] = pt; });
+      }
+      else
+      {
+        auto &facts = blockFacts[&BB];
+        firstTime = !facts.visited;
+        facts.visited = true;
+        transferBB(BB, curIN, curAliIN, curPtIN);
+      }
+
+      bool changed = mergeDefs(blockRDAOut<S>(&BB), curIN);
+      changed |= blockAliOut<S>(&BB).merge(curAliIN);
+      changed |= mergeAliases(blockPtOut<S>(&BB), curPtIN);
+
+      // if the block is analyzed for the first time, then we need to add its successors to the worklist
+      return changed || firstTime;
+    }
+
+    // the facts at the entry of a block analyzed by the block engine, merged again from the exits of its predecessors
+    // at the fixed point, the exits of the predecessors are the ones the last visit of the block merged, since a change
+    // to one of them would have queued the block again
+    bool blockEntry(BasicBlock *BB, BlockRDASet &curIN, AliasClasses &curAliIN, AliasSet &curPtIN)
+    {
+      auto it = blockFacts.find(BB);
+      if (it == blockFacts.end() || !it->second.visited)
+        return false;
+      initBlockEntry(*BB, curIN, curAliIN, curPtIN);
+      return true;
+    }
+
+    // run the transfer function of a block analyzed by the block engine once more, from the merged exits of its
+    // predecessors, and link the pointer operands of its CAT instructions to the definitions reaching them
+    void materializeBlock(BasicBlock *BB)
+    {
+      BlockRDASet curIN;
+      AliasClasses curAliIN;
+      AliasSet curPtIN;
+      if (!blockEntry(BB, curIN, curAliIN, curPtIN))
+        return;
+
+      DefSet none;
+      transferBB<BlockRDASet>(*BB, curIN, curAliIN, curPtIN, [&](Instruction &I, BlockRDASet &rda, AliasClasses &, AliasSet &, bool isOut)
+                            {
+                              auto type = getInstType(I);
+                              if (isOut || (type != CAT_GET && type != CAT_MOD))
+                                return;
+                              for (auto &arg : cast<CallInst>(&I)->args())
+                              {
+                                if (!arg->getType()->isPointerTy())
+                                  continue;
+                                auto valIt = valueIndex.find(arg);
+                                bool known = valIt != valueIndex.end() && valIt->second < rda.defs.size();
+                                useGraph.link(&I, arg, known ? rda.defs[valIt->second] : none);
+                              } });
+    }
+
+    // link the CAT uses of every block eagerly, right after the fixed point, while the IR is still the one it analyzed
+    // running a block again after folding, redundant call elimination or dead code elimination rewrote it would not
+    // reproduce the facts they relied on, so nothing is computed on demand: the calls they create inherit the nodes of
+    // the calls they replace
+    // the graph keeps a node per distinct set of reaching definitions and an entry per pointer operand of a CAT call, nothing
+    // bounds them but the size of the function, and they live as long as the context
+    void materializeBlocks()
+    {
+      for (auto &BB : *curFunc)
+        if (llvm::any_of(BB, [&](Instruction &I)
+                         { auto type = getInstType(I); return type == CAT_GET || type == CAT_MOD; }))
+          materializeBlock(&BB);
+    }
+
+    // the node of an operand of a CAT call, which is only missing for the operands that aren't pointers and in the blocks the
+    // fixed point never reached
+    DefUseGraph::Node *findUse(Instruction *I, Value *v)
+    {
+      auto *node = useGraph.find(I, v);
+      assert((node || !v->getType()->isPointerTy() || !blockFacts.count(I->getParent()) || !blockFacts.find(I->getParent())->second.visited) &&
+             "CAT use not linked before the rewrites");
+      return node;
+    }
+
+    SmallVector<Instruction *, 4> mapReachingDefs(Instruction *I, Value *v)
+    {
+      SmallVector<Instruction *, 4> defs;
+      auto &curIN = IN[I];
+      auto it = curIN.find(v);
+      if (it != curIN.end())
+        defs.append(it->second.begin(), it->second.end());
+      return defs;
+    }
+
+    SmallVector<Instruction *, 4> blockReachingDefs(Instruction *I, Value *v)
+    {
+      SmallVector<Instruction *, 4> defs;
+      if (auto *node = findUse(I, v))
+        for (auto idx : node->defs)
+          defs.push_back(defList[idx]);
+      return defs;
+    }
+
+    // the definitions of v that reach the instruction I
+    SmallVector<Instruction *, 4> reachingDefsAt(Instruction *I, Value *v)
+    {
+      return RDAEngine == MAP_RDA ? mapReachingDefs(I, v) : blockReachingDefs(I, v);
+    }
+
+    RDASet toRDASet(BlockRDASet &rda)
+    {
+      RDASet converted;
+      for (auto &pair : valueIndex)
+        if (pair.second < rda.defs.size())
+          for (auto idx : rda.defs[pair.second])
+            converted[pair.first].insert(defList[idx]);
+      return converted;
+    }
+
+    void dumpRDAInfo()
+    {
+      // the block engine does not keep per-instruction facts, so rebuild all of them for the dump
+      if (RDAEngine == BLOCK_RDA)
+        for (auto &BB : *curFunc)
+        {
+          BlockRDASet curIN;
+          AliasClasses curAliIN;
+          AliasSet curPtIN;
+          if (!blockEntry(&BB, curIN, curAliIN, curPtIN))
+            continue;
+          transferBB<BlockRDASet>(BB, curIN, curAliIN, curPtIN, [&](Instruction &I, BlockRDASet &rda, AliasClasses &, AliasSet &pt, bool isOut)
+                                {
+                                  (isOut ? OUT : IN)[&I] = toRDASet(rda);
+                                  (isOut ? ptOUT : ptIN)[&I] = pt; });
+        }
+
+      log << "Function \"" << curFunc->getName() << "\"\n";
+
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+        {
+          log << "INSTRUCTION: " << I << "\n***************** RDA IN\n{\n";
+          for (auto &pair : IN[&I])
+          {
+            log << "DEF OF " << *pair.first << ":\n";
+            for (auto *def : pair.second)
+              if (def)
+                log << "  " << *def << "\n";
+              else
+                log << "  UNKNOWN\n";
+          }
+          log << "}\n**************************************\n";
+
+          log << "***************** POINT-TO IN\n{\n";
+          for (auto &pair : ptIN[&I])
+          {
+            log << "DEF OF " << *pair.first << ":\n";
+            for (auto *def : pair.second)
+              if (def)
+                log << "  " << *def << "\n";
+              else
+                log << "  UNKNOWN\n";
+          }
+          log << "}\n**************************************\n";
+
+          log << "***************** RDA OUT\n{\n";
+          for (auto &pair : OUT[&I])
+          {
+            log << "DEF OF " << *pair.first << ":\n";
+            for (auto *def : pair.second)
+              if (def)
+                log << "  " << *def << "\n";
+              else
+                log << "  UNKNOWN\n";
+          }
+          log << "}\n**************************************\n";
+
+          log << "***************** POINT-TO OUT\n{\n";
+          for (auto &pair : ptOUT[&I])
+          {
+            log << "DEF OF " << *pair.first << ":\n";
+            for (auto *def : pair.second)
+              if (def)
+                log << "  " << *def << "\n";
+              else
+                log << "  UNKNOWN\n";
+          }
+          log << "}\n**************************************\n";
+        }
+    }
+
+    void dumpTypeInfo()
+    {
+      log << "Function \"" << curFunc->getName() << "\"\n";
+      log << "CAT data:\n";
+      forEachCATValue([&](Value *v, VType type)
+                      { if (type == CAT_DATA) log << "  " << *v << "\n"; });
+      log << "CAT pointers:\n";
+      forEachCATValue([&](Value *v, VType type)
+                      { if (type == CAT_PTR) log << "  " << *v << "\n"; });
+    }
+
+    ConstantInt *getIfIsConstant(Value *operand, Instruction *user)
+    {
+      bool final;
+      if (RDAEngine == MAP_RDA)
+        return getIfAllConstant(mapReachingDefs(user, operand), user, final);
+
+      // operands sharing a node share the answer once it's final
+      auto *node = findUse(user, operand);
+      if (!node)
+        return nullptr;
+      if (!node->final)
+        node->constant = getIfAllConstant(blockReachingDefs(user, operand), user, node->final);
+      return node->constant;
+    }
+
+    // the constant defined by all the definitions, if any
+    // final is set when folding and propagation can't change the answer anymore
+    ConstantInt *getIfAllConstant(const SmallVector<Instruction *, 4> &defs, Instruction *user, bool &final)
+    {
+      ConstantInt *constant = nullptr;
+      final = true;
+
+      for (auto *def : defs)
+      {
+        // def may be UNKNOWN, which means the operand may be defined outside the function
+        if (def == UNKNOWN)
+          return nullptr;
+        // the answer changes only if this definition is rewritten
+        defQueries[def].push_back(cast<CallInst>(user));
+
+        if (auto *replacement = deleteMap.lookup(def))
+          def = replacement;
+
+        Value *candidate = nullptr;
+        if (auto *callInst = dyn_cast<CallInst>(def))
+        {
+          auto api = getApi(callInst);
+          if (api == API_NEW)
+            candidate = callInst->getOperand(0);
+          else if (api == API_SET)
+            candidate = callInst->getOperand(1);
+          else
+          {
+            // created by a summarized function, and not by CAT_add, CAT_sub, or passed into functions
+            auto it = callSummaries.find(callInst);
+            if (it != callSummaries.end() && it->second.summarized)
+              candidate = it->second.returnConstant;
+          }
+        }
+
+        if (auto *propagated = propMap.lookup(candidate))
+          candidate = propagated;
+
+        if (!candidate || !isa<ConstantInt>(candidate))
+        {
+          final = false;
+          return nullptr;
+        }
+
+        if (!constant)
+          constant = cast<ConstantInt>(candidate);
+        else if (constant->getValue() != cast<ConstantInt>(candidate)->getValue())
+          return nullptr;
+      }
+
+      return constant;
+    }
+
+    // fold a CAT_add or CAT_sub into a CAT_set if its operands allow it
+    // the new instructions are inserted before the old one, which is erased at the end of the fixed point
+    bool constantFoldAndAlgSimp(CallInst *callInst, std::vector<CallInst *> &created)
+    {
+      auto timer = timePhase(&PhaseTimers::fold);
+      bool isAdd = getApi(callInst) == API_ADD, folded = false;
+      IRBuilder<> builder(callInst);
+      Value *newOperand;
+
+      // check if all the definitions of the operands that reach the call instruction are constant
+      auto op1 = callInst->getOperand(1);
+      auto op2 = callInst->getOperand(2);
+
+      // algebraic simplification of sub: x - x = 0
+      if (!isAdd && op1 == op2)
+        newOperand = ConstantInt::get(Type::getInt64Ty(curFunc->getContext()), 0);
+      else
+      {
+        // check the constantness of the operands
+        auto *constant1 = getIfIsConstant(op1, callInst), *constant2 = getIfIsConstant(op2, callInst);
+        if (!constant1 && !constant2)
+          return false;
+
+        // if both operands are constant, constant fold
+        if ((folded = constant1 && constant2))
+          newOperand = isAdd ? builder.CreateAdd(constant1, constant2) : builder.CreateSub(constant1, constant2);
+        // if one of the operands is constant 0, then we can do the algebraic simplification
+        // without a declaration of CAT_get, the value of the other operand can't be read
+        else if (!getApiDecl(API_GET))
+          return false;
+        else if (!constant1 && isa<ConstantInt>(constant2) && cast<ConstantInt>(constant2)->getValue() == 0)
+          newOperand = builder.CreateCall(getApiDecl(API_GET), std::vector<Value *>({op1}));
+        else if (!constant2 && isa<ConstantInt>(constant1) && cast<ConstantInt>(constant1)->getValue() == 0 && isAdd)
+          // if the operation is CAT_sub and the second operand is not constant, then we can't simplify it because we need to do negation
+          newOperand = builder.CreateCall(getApiDecl(API_GET), std::vector<Value *>({op2}));
+        else
+          return false;
+      }
+
+      // a new CAT_get sees the same definitions as the instruction it's inserted before
+      if (auto *getInst = dyn_cast<CallInst>(newOperand))
+      {
+        inheritFacts(getInst, callInst);
+        created.push_back(getInst);
+      }
+      auto *setInst = builder.CreateCall(getApiDecl(API_SET), std::vector<Value *>({callInst->getOperand(0), newOperand}));
+      // and so does the new CAT_set, which the later stages ask about the data it writes
+      inheritFacts(setInst, callInst);
+      deleteMap[callInst] = setInst;
+      created.push_back(setInst);
+      if (folded)
+        NumFolds++;
+      else
+        NumAlgSimps++;
+      if (diagnose)
+      {
+        json::Object fields;
+        if (auto *constant = dyn_cast<ConstantInt>(newOperand))
+          fields["constant"] = constant->getSExtValue();
+        else
+          fields["value"] = describe(newOperand);
+        report(folded ? "fold" : "algsimp", callInst, std::move(fields));
+      }
+      return true;
+    }
+
+    // replace a CAT_get by the constant it reads, if any
+    bool constantProp(CallInst *callInst)
+    {
+      auto timer = timePhase(&PhaseTimers::prop);
+      auto *constant = getIfIsConstant(callInst->getOperand(0), callInst);
+      if (!constant)
+        return false;
+
+      callInst->replaceAllUsesWith(constant);
+      propMap[callInst] = constant;
+      NumProps++;
+      if (diagnose)
+        report("prop", callInst, json::Object{{"constant", constant->getSExtValue()}});
+      return true;
+    }
+
+    void inheritFacts(Instruction *newInst, Instruction *from)
+    {
+      if (diagnose)
+        diagNumbers[newInst] = diagNumbers.lookup(from);
+      if (RDAEngine == MAP_RDA)
+        IN[newInst] = IN[from];
+      else
+        // only the pointer operands are linked, and their nodes are copied without running the block of from again
+        for (auto &arg : cast<CallInst>(newInst)->args())
+          if (arg->getType()->isPointerTy())
+            useGraph.copy(newInst, from, arg);
+    }
+
+    // fold and propagate until nothing changes
+    // a rewrite never changes which definitions reach an instruction, only what they define,
+    // so the RDA facts stay valid and only the instructions that queried a rewritten definition are visited again
+    bool constantFoldAndProp()
+    {
+      bool canFold = getApiDecl(API_SET) != nullptr;
+      std::queue<CallInst *> worklist;
+      std::vector<CallInst *> deleteList;
+      // the definitions each new CAT_set replaces
+      DenseMap<Instruction *, Instruction *> foldedFrom;
+      defQueries.clear();
+      if (diagnose)
+      {
+        diagRound = ++diagnostics->foldings[curFunc];
+        diagNumbers.clear();
+        for (auto &B : *curFunc)
+          for (auto &I : B)
+            diagNumbers[&I] = diagNumbers.size();
+      }
+
+      // fold before propagating, in program order
+      for (auto &B : *curFunc)
+        for (auto &I : B)
+          if (getInstType(I) == CAT_MOD && canFold && getApi(cast<CallInst>(&I)) != API_SET)
+            worklist.push(cast<CallInst>(&I));
+      for (auto &B : *curFunc)
+        for (auto &I : B)
+          if (getInstType(I) == CAT_GET)
+            worklist.push(cast<CallInst>(&I));
+
+      auto revisit = [&](Instruction *def)
+      {
+        auto it = defQueries.find(def);
+        if (it == defQueries.end())
+          return;
+        for (auto *user : it->second)
+          worklist.push(user);
+        defQueries.erase(it);
+      };
+
+      std::set<CallInst *> done;
+      while (!worklist.empty())
+      {
+        auto *callInst = worklist.front();
+        worklist.pop();
+        if (done.count(callInst))
+          continue;
+        NumFoldVisits++;
+
+        if (getInstType(*callInst) == CAT_GET)
+        {
+          // the definitions using the read value now define a constant
+          SmallVector<User *, 4> users(callInst->users());
+          if (!constantProp(callInst))
+            continue;
+          for (auto *U : users)
+            if (auto *defInst = dyn_cast<CallInst>(U))
+            {
+              revisit(defInst);
+              if (foldedFrom.count(defInst))
+                revisit(foldedFrom[defInst]);
+            }
+        }
+        else
+        {
+          std::vector<CallInst *> created;
+          if (!constantFoldAndAlgSimp(callInst, created))
+            continue;
+          for (auto *newInst : created)
+            if (getInstType(*newInst) == CAT_GET)
+              worklist.push(newInst);
+            else
+              foldedFrom[newInst] = callInst;
+          revisit(callInst);
+        }
+
+        done.insert(callInst);
+        deleteList.push_back(callInst);
+      }
+
+      if (diagnose)
+        reportBlocked(done, canFold);
+      for (auto *I : deleteList)
+      {
+        instTypes.erase(I);
+        I->eraseFromParent();
+      }
+      // the def-use graph is built as the fixed point queries it
+      MaxDefUseNodes.updateMax(useGraph.size());
+
+      return deleteList.size() > 0;
+    }
+
+    // the text of an instruction, or the type and name of another value
+    static std::string describe(Value *v)
+    {
+      std::string text;
+      raw_string_ostream OS(text);
+      if (isa<Instruction>(v))
+        OS << *v;
+      else
+        v->printAsOperand(OS, true);
+      return StringRef(OS.str()).trim().str();
+    }
+
+    // the name of a value as an operand, without the %
+    static std::string operandName(Value *v)
+    {
+      std::string text;
+      raw_string_ostream OS(text);
+      v->printAsOperand(OS, false);
+      return StringRef(OS.str()).ltrim('%').str();
+    }
+
+    // write a diagnostics event about a CAT call, unless the filters leave the call out
+    void report(StringRef event, CallInst *callInst, json::Object fields)
+    {
+      auto number = diagNumbers.lookup(callInst);
+      if (!diagnostics->matchesNumber(number))
+        return;
+      if (!DiagnosticsValue.empty())
+      {
+        auto wanted = StringRef(DiagnosticsValue).ltrim('%');
+        if (none_of(callInst->args(), [&](Value *arg)
+                    { return operandName(arg) == wanted; }))
+          return;
+      }
+      fields["event"] = event;
+      fields["function"] = curFunc->getName();
+      fields["round"] = diagRound;
+      fields["inst"] = number;
+      fields["call"] = describe(callInst);
+      diagnostics->write(std::move(fields));
+    }
+
+    // report the CAT_add, CAT_sub and CAT_get the folding left, with the reason each of their operands isn't constant
+    void reportBlocked(const std::set<CallInst *> &done, bool canFold)
+    {
+      for (auto &B : *curFunc)
+        for (auto &I : B)
+        {
+          auto type = getInstType(I);
+          if (type != CAT_GET && type != CAT_MOD)
+            continue;
+          auto *callInst = cast<CallInst>(&I);
+          if (done.count(callInst) || getApi(callInst) == API_SET)
+            continue;
+          if (type == CAT_MOD && !canFold)
+          {
+            report("blocked", callInst, json::Object{{"reason", "missing-cat-set"}});
+            continue;
+          }
+
+          SmallVector<Value *, 2> operands;
+          if (type == CAT_GET)
+            operands.push_back(callInst->getArgOperand(0));
+          else
+            operands.append({callInst->getArgOperand(1), callInst->getArgOperand(2)});
+          for (auto *operand : operands)
+          {
+            json::Array by;
+            auto reason = explainOperand(operand, callInst, by);
+            if (!reason.empty())
+              report("blocked", callInst, json::Object{{"operand", operandName(operand)}, {"reason", reason}, {"by", std::move(by)}});
+          }
+        }
+    }
+
+    // why the definitions of an operand don't define a single constant, empty if they do
+    // the definitions or the values responsible are added to by
+    std::string explainOperand(Value *operand, CallInst *user, json::Array &by)
+    {
+      auto defs = reachingDefsAt(user, operand);
+      if (defs.empty())
+        return "no-definition";
+      if (is_contained(defs, UNKNOWN))
+        return explainUnknown(operand, user, by);
+
+      ConstantInt *constant = nullptr;
+      for (auto *def : defs)
+      {
+        if (auto *replacement = deleteMap.lookup(def))
+          def = replacement;
+        Value *candidate = nullptr;
+        if (auto *callInst = dyn_cast<CallInst>(def))
+        {
+          auto api = getApi(callInst);
+          if (api == API_NEW)
+            candidate = callInst->getArgOperand(0);
+          else if (api == API_SET)
+            candidate = callInst->getArgOperand(1);
+          else if (api == NOT_API)
+          {
+            auto it = callSummaries.find(callInst);
+            if (it == callSummaries.end() || !it->second.summarized)
+            {
+              by = json::Array{describe(def)};
+              return "call-result";
+            }
+            candidate = it->second.returnConstant;
+          }
+        }
+        if (auto *propagated = propMap.lookup(candidate))
+          candidate = propagated;
+
+        auto *value = dyn_cast_or_null<ConstantInt>(candidate);
+        if (!value)
+        {
+          by = json::Array{describe(def)};
+          return "non-constant-definition";
+        }
+        by.push_back(describe(def));
+        if (constant && constant->getValue() != value->getValue())
+          return "conflicting-constants";
+        constant = value;
+      }
+      by.clear();
+      return "";
+    }
+
+    // an UNKNOWN definition reaches the operand: either its data comes from outside the function, through arguments,
+    // globals, loads or calls, and by lists where, or it's created here and a call may have modified it, and by lists
+    // the calls that may have
+    std::string explainUnknown(Value *operand, CallInst *user, json::Array &by)
+    {
+      auto roots = findDataRoots(operand);
+      bool external = false;
+      for (auto *root : roots)
+        if (!isa<Instruction>(root) || getInstType(*cast<Instruction>(root)) != CAT_NEW)
+        {
+          by.push_back(describe(root));
+          external = true;
+        }
+      if (external)
+        return "unknown-definition";
+
+      // in program order, the calls that may modify the data before the operand is read
+      for (auto &B : *curFunc)
+        for (auto &I : B)
+        {
+          auto *callInst = dyn_cast<CallInst>(&I);
+          auto it = callInst ? callSummaries.find(callInst) : callSummaries.end();
+          if (it == callSummaries.end() || !isPotentiallyReachable(callInst, user))
+            continue;
+          auto &summary = it->second;
+          bool clobbers = summary.summarized ? any_of(summary.killedData, [&](Value *data)
+                                                      { return any_of(findDataRoots(data), [&](Value *root)
+                                                                      { return is_contained(roots, root); }); })
+                                             : any_of(roots, [&](Value *root)
+                                                      { return isDataModifiedByCall(summary, callInst, root); });
+          if (clobbers)
+            by.push_back(describe(callInst));
+        }
+      return "call-clobber";
+    }
+
+    // the values the data v comes from, through PHIs, selects and bitcasts
+    SmallVector<Value *, 4> findDataRoots(Value *v)
+    {
+      SmallVector<Value *, 4> roots;
+      SmallPtrSet<Value *, 8> visited = {v};
+      SmallVector<Value *, 8> worklist = {v};
+      while (!worklist.empty())
+      {
+        auto *cur = worklist.pop_back_val();
+        SmallVector<Value *, 4> sources;
+        if (auto *phiNode = dyn_cast<PHINode>(cur))
+          sources.append(phiNode->incoming_values().begin(), phiNode->incoming_values().end());
+        else if (auto *selectInst = dyn_cast<SelectInst>(cur))
+          sources.append({selectInst->getTrueValue(), selectInst->getFalseValue()});
+        else if (auto *bitcastInst = dyn_cast<BitCastInst>(cur))
+          sources.push_back(bitcastInst->getOperand(0));
+        else
+          roots.push_back(cur);
+        for (auto *source : sources)
+          if (visited.insert(source).second)
+            worklist.push_back(source);
+      }
+      return roots;
+    }
+
+    // whether an instruction that may execute after from and before to, without from executing again, satisfies pred
+    // from dominates to, so the blocks in between are the ones found walking back from to until the block of from
+    bool anyBetween(Instruction *from, Instruction *to, function_ref<bool(Instruction &)> pred)
+    {
+      auto *fromBB = from->getParent(), *toBB = to->getParent();
+      auto inRange = [&](BasicBlock::iterator begin, BasicBlock::iterator end)
+      {
+        return std::any_of(begin, end, [&](Instruction &I)
+                           { return pred(I); });
+      };
+      if (fromBB == toBB)
+        return inRange(std::next(from->getIterator()), to->getIterator());
+
+      SmallPtrSet<BasicBlock *, 16> between;
+      SmallVector<BasicBlock *, 16> worklist(pred_begin(toBB), pred_end(toBB));
+      while (!worklist.empty())
+      {
+        auto *BB = worklist.pop_back_val();
+        if (BB != fromBB && between.insert(BB).second)
+          worklist.append(pred_begin(BB), pred_end(BB));
+      }
+      // to is between itself and from if the walk came back to its block
+      if (inRange(std::next(from->getIterator()), fromBB->end()) || (!between.count(toBB) && inRange(toBB->begin(), to->getIterator())))
+        return true;
+      return llvm::any_of(between, [&](BasicBlock *BB)
+                          { return inRange(BB->begin(), BB->end()); });
+    }
+
+    // whether the CAT data the operands of later refer to is the same as at earlier, which dominates it
+    // the definitions reaching later must all execute before earlier, the UNKNOWN ones included: the calls may define
+    // data as UNKNOWN, the other UNKNOWN definitions come from outside the function or from loads, which dominate both
+    // a CAT_add or CAT_sub defined by its leader must also leave its operands alone
+    bool sameDataAt(CallInst *earlier, CallInst *leader, CallInst *later)
+    {
+      SmallPtrSet<Instruction *, 8> defs;
+      bool unknown = false;
+      for (unsigned i = 0; i < later->arg_size(); i++)
+      {
+        if (!later->getArgOperand(i)->getType()->isPointerTy())
+          continue;
+        for (auto *def : reachingDefsAt(later, later->getArgOperand(i)))
+        {
+          if (def == UNKNOWN)
+          {
+            unknown = true;
+            continue;
+          }
+          if (auto *replacement = deleteMap.lookup(def))
+            def = replacement;
+          if (i > 0 && def == leader)
+            return false;
+          defs.insert(def);
+        }
+      }
+      return !anyBetween(earlier, later, [&](Instruction &I)
+                         { return defs.count(&I) || (unknown && getInstType(I) == MISC_FUNC); });
+    }
+
+    // value numbering of the CAT calls: a CAT_get reading the same data as an earlier one is replaced by it, and a
+    // CAT_add or CAT_sub repeating an earlier one on the same data is removed, since its result already holds the value
+    // the calls are numbered by operands in a walk of the dominator tree, so the earlier calls found dominate the later
+    // ones, and the RDA facts of the later call tell whether the data may change in between
+    bool eliminateRedundantCalls()
+    {
+      if (!EliminateRedundantCalls)
+        return false;
+      auto timer = timePhase(&PhaseTimers::cse);
+      typedef std::tuple<unsigned, Value *, Value *, Value *> CallKey;
+      // the calls available at the current block, with the call each of them is redundant with
+      DenseMap<CallKey, SmallVector<std::pair<CallInst *, CallInst *>, 2>> available;
+      DenseMap<DomTreeNode *, SmallVector<CallKey, 4>> numbered;
+      SmallVector<CallInst *, 32> redundant;
+      DominatorTree DT(*curFunc);
+
+      SmallVector<std::pair<DomTreeNode *, bool>, 32> stack = {{DT.getRootNode(), false}};
+      while (!stack.empty())
+      {
+        auto [node, done] = stack.pop_back_val();
+        if (done)
+        {
+          for (auto &key : numbered[node])
+            available[key].pop_back();
+          continue;
+        }
+        stack.push_back({node, true});
+        for (auto *child : *node)
+          stack.push_back({child, false});
+
+        for (auto &I : *node->getBlock())
+        {
+          auto *callInst = dyn_cast<CallInst>(&I);
+          auto api = callInst ? getApi(callInst) : NOT_API;
+          if (api != API_GET && api != API_ADD && api != API_SUB)
+            continue;
+          CallKey key = api == API_GET ? CallKey(api, callInst->getArgOperand(0), nullptr, nullptr)
+                                       : CallKey(api, callInst->getArgOperand(0), callInst->getArgOperand(1), callInst->getArgOperand(2));
+          auto &calls = available[key];
+          auto *leader = callInst;
+          if (!calls.empty() && sameDataAt(calls.back().first, calls.back().second, callInst))
+          {
+            leader = calls.back().second;
+            if (api == API_GET)
+            {
+              callInst->replaceAllUsesWith(leader);
+              NumRedundantGets++;
+            }
+            else
+            {
+              // the definitions of the removed call are the ones of its leader
+              deleteMap[callInst] = leader;
+              NumRedundantDefs++;
+            }
+            redundant.push_back(callInst);
+          }
+          calls.push_back({callInst, leader});
+          numbered[node].push_back(key);
+        }
+      }
+
+      for (auto *I : redundant)
+      {
+        instTypes.erase(I);
+        I->eraseFromParent();
+      }
+      return !redundant.empty();
+    }
+
+    // the CAT_new whose data only the CAT calls of this function can reach: all their uses, through PHIs, selects and
+    // bitcasts, are operands of CAT calls
+    SmallPtrSet<Instruction *, 16> findLocalObjects()
+    {
+      SmallPtrSet<Instruction *, 16> local;
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+        {
+          if (getInstType(I) != CAT_NEW)
+            continue;
+          bool escapes = false;
+          SmallPtrSet<Value *, 8> visited = {&I};
+          SmallVector<Value *, 8> worklist = {&I};
+          while (!worklist.empty() && !escapes)
+            for (auto &U : worklist.pop_back_val()->uses())
+            {
+              auto *user = U.getUser();
+              if (auto *callInst = dyn_cast<CallInst>(user))
+              {
+                auto api = getApi(callInst);
+                escapes |= !callInst->isArgOperand(&U) || api == NOT_API || api == API_NEW || api == API_IGNORED;
+              }
+              else if (isa<PHINode>(user) || isa<BitCastInst>(user) || (isa<SelectInst>(user) && U.getOperandNo() != 0))
+              {
+                if (visited.insert(user).second)
+                  worklist.push_back(user);
+              }
+              else
+                escapes = true;
+            }
+          if (!escapes)
+            local.insert(&I);
+        }
+      return local;
+    }
+
+    // whether all the data v may refer to is created by local objects
+    bool refersToLocalObjects(Value *v, const SmallPtrSetImpl<Instruction *> &local)
+    {
+      SmallPtrSet<Value *, 8> visited = {v};
+      SmallVector<Value *, 8> worklist = {v};
+      while (!worklist.empty())
+      {
+        auto *cur = worklist.pop_back_val();
+        SmallVector<Value *, 4> sources;
+        if (auto *phiNode = dyn_cast<PHINode>(cur))
+          sources.append(phiNode->incoming_values().begin(), phiNode->incoming_values().end());
+        else if (auto *selectInst = dyn_cast<SelectInst>(cur))
+          sources.append({selectInst->getTrueValue(), selectInst->getFalseValue()});
+        else if (auto *bitcastInst = dyn_cast<BitCastInst>(cur))
+          sources.push_back(bitcastInst->getOperand(0));
+        else if (!isa<Instruction>(cur) || !local.count(cast<Instruction>(cur)))
+          return false;
+        for (auto *source : sources)
+          if (visited.insert(source).second)
+            worklist.push_back(source);
+      }
+      return true;
+    }
+
+    // remove the CAT definitions of local objects that no read sees, the unused CAT_get, and then the local objects
+    // left with nothing but their CAT_destroy
+    // the definitions of the data that escapes are live, and a live CAT_add or CAT_sub makes the definitions reaching its
+    // operands live, the RDA facts of the folding still tell which ones
+    bool eliminateDeadCode()
+    {
+      if (!EliminateDeadCode)
+        return false;
+      auto timer = timePhase(&PhaseTimers::dce);
+      auto local = findLocalObjects();
+
+      SmallPtrSet<Instruction *, 32> live;
+      SmallVector<CallInst *, 32> readers;
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+        {
+          auto type = getInstType(I);
+          auto *callInst = dyn_cast<CallInst>(&I);
+          if (type == CAT_GET && !I.use_empty())
+            readers.push_back(callInst);
+          else if (type == CAT_MOD && !refersToLocalObjects(callInst->getArgOperand(0), local))
+          {
+            live.insert(callInst);
+            if (getApi(callInst) != API_SET)
+              readers.push_back(callInst);
+          }
+        }
+
+      while (!readers.empty())
+      {
+        auto *reader = readers.pop_back_val();
+        // CAT_get reads its only operand, CAT_add and CAT_sub read the two after the one they write
+        for (unsigned i = getApi(reader) == API_GET ? 0 : 1; i < reader->arg_size(); i++)
+          for (auto *def : reachingDefsAt(reader, reader->getArgOperand(i)))
+          {
+            if (def == UNKNOWN)
+              continue;
+            if (auto *replacement = deleteMap.lookup(def))
+              def = replacement;
+            if (!live.insert(def).second)
+              continue;
+            auto *defInst = dyn_cast<CallInst>(def);
+            if (defInst && (getApi(defInst) == API_ADD || getApi(defInst) == API_SUB))
+              readers.push_back(defInst);
+          }
+      }
+
+      SmallVector<Instruction *, 32> dead;
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+        {
+          auto type = getInstType(I);
+          if (type == CAT_MOD && !live.count(&I))
+          {
+            dead.push_back(&I);
+            NumDeadDefs++;
+          }
+          else if (type == CAT_GET && I.use_empty())
+          {
+            dead.push_back(&I);
+            NumDeadGets++;
+          }
+        }
+      for (auto *I : dead)
+      {
+        instTypes.erase(I);
+        erasedDefs.insert(I);
+        I->eraseFromParent();
+      }
+
+      // the objects left with their CAT_destroy only
+      bool changed = !dead.empty();
+      for (auto *newInst : local)
+      {
+        if (!llvm::all_of(newInst->users(), [&](User *U)
+                          { return isa<CallInst>(U) && getApi(cast<CallInst>(U)) == API_DESTROY; }))
+          continue;
+        SmallVector<User *, 2> destroys(newInst->users());
+        for (auto *U : destroys)
+          cast<Instruction>(U)->eraseFromParent();
+        instTypes.erase(newInst);
+        erasedDefs.insert(newInst);
+        newInst->eraseFromParent();
+        NumDeadObjects++;
+        changed = true;
+      }
+      return changed;
+    }
+
+    // move the loop-invariant CAT calls of a loop out of it, see hoistLoopInvariants
+    bool hoistFromLoop(Loop *loop, DominatorTree &DT)
+    {
+      auto *preheader = loop->getLoopPreheader();
+      if (!preheader)
+        return false;
+      SmallVector<BasicBlock *, 4> exiting;
+      loop->getExitingBlocks(exiting);
+      // the CAT_set are sunk into the single exit of the loop, which only the loop reaches
+      auto *exit = loop->hasDedicatedExits() ? loop->getExitBlock() : nullptr;
+      // the calls moved out of the loop must run in every iteration, or they would run when the loop doesn't run them
+      // a loop without exiting blocks never reaches its exit, and a call skipped on the way to the latch doesn't run in
+      // every iteration even if the loop only exits through a call like exit()
+      auto *latch = loop->getLoopLatch();
+      auto alwaysRuns = [&](Instruction *I)
+      {
+        return !exiting.empty() && latch && DT.dominates(I->getParent(), latch) &&
+               llvm::all_of(exiting, [&](BasicBlock *BB)
+                            { return DT.dominates(I->getParent(), BB); });
+      };
+      // the calls of the loop may define data as UNKNOWN, or read the data written there
+      bool calls = llvm::any_of(loop->blocks(), [&](BasicBlock *BB)
+                                { return llvm::any_of(*BB, [&](Instruction &I)
+                                                      { return getInstType(I) == MISC_FUNC; }); });
+      auto defsOf = [&](CallInst *callInst, unsigned i)
+      {
+        auto defs = reachingDefsAt(callInst, callInst->getArgOperand(i));
+        for (auto *&def : defs)
+          if (auto *replacement = deleteMap.lookup(def))
+            def = replacement;
+        return defs;
+      };
+
+      bool changed = false;
+      for (bool moved = true; moved;)
+      {
+        moved = false;
+        // the reads of the loop with the definitions they see, and the definitions of the loop with the ones of their data
+        SmallVector<SmallVector<Instruction *, 4>, 16> reads;
+        SmallVector<std::pair<CallInst *, SmallVector<Instruction *, 4>>, 16> overwrites;
+        SmallVector<CallInst *, 16> candidates;
+        for (auto *BB : loop->blocks())
+          for (auto &I : *BB)
+          {
+            auto *callInst = dyn_cast<CallInst>(&I);
+            auto api = callInst ? getApi(callInst) : NOT_API;
+            if (api == API_GET)
+              reads.push_back(defsOf(callInst, 0));
+            else if (api == API_ADD || api == API_SUB)
+              reads.append({defsOf(callInst, 1), defsOf(callInst, 2)});
+            else if (api != API_SET)
+              continue;
+            if (api != API_GET)
+              overwrites.push_back({callInst, defsOf(callInst, 0)});
+            if (llvm::all_of(callInst->args(), [&](Use &arg)
+                             { return loop->isLoopInvariant(arg.get()); }) &&
+                alwaysRuns(callInst))
+              candidates.push_back(callInst);
+          }
+
+        // a read is invariant if the definitions it sees are all outside of the loop
+        auto invariantRead = [&](CallInst *callInst, unsigned i)
+        {
+          return llvm::all_of(defsOf(callInst, i), [&](Instruction *def)
+                              { return def == UNKNOWN ? !calls : !loop->contains(def); });
+        };
+        // whether a read sees def, or sees it with other definitions
+        auto seenByReads = [&](CallInst *def, bool alone)
+        {
+          return llvm::any_of(reads, [&](const SmallVector<Instruction *, 4> &defs)
+                              { return llvm::is_contained(defs, def) && (!alone || defs.size() > 1); });
+        };
+        // the facts of a definition may still see the erased definitions that killed def, so they may see def now
+        auto seenByDefs = [&](CallInst *def)
+        {
+          return llvm::any_of(overwrites, [&](const std::pair<CallInst *, SmallVector<Instruction *, 4>> &other)
+                              { return other.first != def && llvm::any_of(other.second, [&](Instruction *seen)
+                                                                          { return seen == def || erasedDefs.count(seen); }); });
+        };
+        for (auto *callInst : candidates)
+        {
+          auto api = getApi(callInst);
+          // a definition moved out of the loop must be the last one of its data in every iteration: no other definition of the
+          // loop sees it, its data is read there only after it, and not by calls
+          bool lastDef = api == API_GET || (!calls && !seenByDefs(callInst) && !seenByReads(callInst, true));
+          if (!lastDef)
+            continue;
+          // a CAT_set no read of the loop sees is only seen at the exits
+          if (api == API_SET && !seenByReads(callInst, false) && exit)
+          {
+            callInst->moveBefore(&*exit->getFirstInsertionPt());
+            NumSunk++;
+          }
+          else if (api == API_GET ? invariantRead(callInst, 0) : api == API_SET || (invariantRead(callInst, 1) && invariantRead(callInst, 2)))
+          {
+            callInst->moveBefore(preheader->getTerminator());
+            NumHoisted++;
+          }
+          else
+            continue;
+          moved = changed = true;
+          break;
+        }
+      }
+      return changed;
+    }
+
+    // LICM of the CAT calls, inner loops first: the CAT_get whose data no definition of the loop reaches, and the CAT_add,
+    // CAT_sub and CAT_set of such data that are the only definitions of their result the loop sees, are hoisted to the
+    // preheader, but the CAT_set that no read of the loop sees are sunk to its exit instead
+    bool hoistLoopInvariants()
+    {
+      if (!HoistInvariants)
+        return false;
+      auto timer = timePhase(&PhaseTimers::licm);
+      DominatorTree DT(*curFunc);
+      LoopInfo LI(DT);
+      bool changed = false;
+      auto loops = LI.getLoopsInPreorder();
+      for (auto *loop : llvm::reverse(loops))
+        changed |= hoistFromLoop(loop, DT);
+      return changed;
+    }
+
+    void RDA()
+    {
+      if (RDAEngine == MAP_RDA || VerifyRDA)
+        solveRDA([this](BasicBlock &BB)
+                 { return RDAinBB<RDASet>(BB); });
+      if (RDAEngine == BLOCK_RDA || VerifyRDA)
+      {
+        blockFacts.reserve(curFunc->size());
+        solveRDA([this](BasicBlock &BB)
+                 { return RDAinBB<BlockRDASet>(BB); });
+        materializeBlocks();
+      }
+      if (VerifyRDA)
+        verifyRDAEngines();
+      if (AreStatisticsEnabled() || !StatsJSON.empty())
+        recordRDASizes();
+    }
+
+    // the peak sizes of the RDA facts
+    void recordRDASizes()
+    {
+      MaxRDAPoints.updateMax(IN.size() + OUT.size());
+      MaxRDABlocks.updateMax(blockFacts.size());
+      for (auto &BB : *curFunc)
+      {
+        unsigned defs = 0;
+        if (RDAEngine == MAP_RDA)
+        {
+          auto it = OUT.find(BB.getTerminator());
+          if (it != OUT.end())
+            for (auto &pair : it->second)
+              defs += pair.second.size();
+        }
+        else
+          for (auto &defSet : blockRDAOut<BlockRDASet>(&BB).defs)
+            defs += defSet.size();
+        MaxReachingDefs.updateMax(defs);
+      }
+    }
+
+    // the fixed point of RDA, alias and point-to propagation
+    void solveRDA(function_ref<bool(BasicBlock &)> analyzeBB)
+    {
+      BlockWorklist toBeAnalyzed(*curFunc);
+      unsigned visits = 0;
+
+      // initialize the worklist with all the blocks without predecessors
+      for (auto &B : *curFunc)
+        if (predecessors(&B).empty())
+          toBeAnalyzed.push(&B);
+
+      while (!toBeAnalyzed.empty())
+      {
+        auto *BB = toBeAnalyzed.pop();
+        visits++;
+
+        // try to analyze the block
+        // if the block is changed, add its successors to the worklist
+        if (analyzeBB(*BB))
+          for (auto *suc : successors(BB))
+            toBeAnalyzed.push(suc);
+      }
+
+      NumRDAVisits += visits;
+      if (ReportIterations)
+        log << "[RDA] function \"" << curFunc->getName() << "\": " << visits << " block visits for " << toBeAnalyzed.size() << " blocks\n";
+    }
+
+    // compare the facts of both engines at every CAT instruction that queries them
+    void verifyRDAEngines()
+    {
+      unsigned mismatches = 0;
+      for (auto &BB : *curFunc)
+        for (auto &I : BB)
+        {
+          auto type = getInstType(I);
+          if (type != CAT_GET && type != CAT_MOD)
+            continue;
+
+          for (auto &arg : cast<CallInst>(&I)->args())
+          {
+            if (checkType(arg) != CAT_DATA)
+              continue;
+            auto mapDefs = mapReachingDefs(&I, arg), blockDefs = blockReachingDefs(&I, arg);
+            if (std::set<Instruction *>(mapDefs.begin(), mapDefs.end()) == std::set<Instruction *>(blockDefs.begin(), blockDefs.end()))
+              continue;
+            log << "[WARNING] RDA engines disagree on " << *arg << " at " << I << "\n";
+            mismatches++;
+          }
+        }
+      if (mismatches)
+        log << "[WARNING] " << mismatches << " RDA mismatches in function \"" << curFunc->getName() << "\"\n";
+    }
+
+  };
+
+  // replace the CAT objects whose uses are all operands of the CAT_add, CAT_sub, CAT_set, CAT_get and CAT_destroy of their
+  // function by i64 values: the calls become loads, stores and integer arithmetic on a slot, which mem2reg promotes
+  // the calls that also use objects kept on the heap read them with a CAT_get and write them with a CAT_set, and heapCalls
+  // tells whether there are any
+  bool promoteLocalObjects(Function &F, const ModuleInfo &moduleInfo, DominatorTree &DT, AssumptionCache &AC, bool &heapCalls)
+  {
+    heapCalls = false;
+    auto timer = timePhase(&PhaseTimers::sroa);
+    auto isAccess = [&moduleInfo](User *U)
+    {
+      auto *callInst = dyn_cast<CallInst>(U);
+      if (!callInst)
+        return false;
+      auto api = moduleInfo.getApi(callInst);
+      return api != NOT_API && api != API_NEW && api != API_IGNORED;
+    };
+
+    SetVector<CallInst *> objects;
+    for (auto &BB : F)
+      for (auto &I : BB)
+      {
+        auto *callInst = dyn_cast<CallInst>(&I);
+        if (!callInst || moduleInfo.getApi(callInst) != API_NEW || !callInst->getArgOperand(0)->getType()->isIntegerTy(64))
+          continue;
+        if (llvm::all_of(callInst->uses(), [&](Use &U)
+                         { return isAccess(U.getUser()) && cast<CallInst>(U.getUser())->isArgOperand(&U); }))
+          objects.insert(callInst);
+      }
+
+    // a call mixing promoted objects with others needs the declarations of CAT_get and CAT_set
+    auto *getDecl = moduleInfo.apiDecls[API_GET], *setDecl = moduleInfo.apiDecls[API_SET];
+    if (!getDecl || !setDecl)
+      for (bool dropped = true; dropped;)
+      {
+        dropped = false;
+        for (auto *newInst : SmallVector<CallInst *, 16>(objects.begin(), objects.end()))
+          if (llvm::any_of(newInst->users(), [&](User *U)
+                           { return llvm::any_of(cast<CallInst>(U)->args(), [&](Use &arg)
+                                                 { return arg->getType()->isPointerTy() && !objects.count(dyn_cast<CallInst>(arg.get())); }); }))
+          {
+            objects.remove(newInst);
+            dropped = true;
+          }
+      }
+    if (objects.empty())
+      return false;
+
+    auto *int64Type = Type::getInt64Ty(F.getContext());
+    IRBuilder<> entry(&F.getEntryBlock(), F.getEntryBlock().getFirstInsertionPt());
+    DenseMap<Value *, AllocaInst *> slots;
+    std::vector<AllocaInst *> allocas;
+    for (auto *newInst : objects)
+    {
+      auto *slot = entry.CreateAlloca(int64Type, nullptr, newInst->getName() + ".value");
+      IRBuilder<>(newInst).CreateStore(newInst->getArgOperand(0), slot);
+      slots[newInst] = slot;
+      allocas.push_back(slot);
+    }
 
-          resetAliasInfo(selectInst, curAliIN, curAliOUT);
-          for (auto *op : {op1, op2})
-            for (auto *alias : curAliIN[op])
-            {
-              curAliOUT[selectInst].insert(alias);
-              curAliOUT[alias].insert(selectInst);
-            }
+    SmallPtrSet<CallInst *, 32> accesses;
+    for (auto &BB : F)
+      for (auto &I : BB)
+        if (isAccess(&I) && llvm::any_of(cast<CallInst>(&I)->args(), [&](Use &arg)
+                                         { return slots.count(arg.get()); }))
+          accesses.insert(cast<CallInst>(&I));
 
-          switch (checkType(selectInst))
-          {
-          case CAT_DATA:
-            curOUT[selectInst].clear();
-            for (auto *op : {op1, op2})
-              curOUT[selectInst].insert(curIN[op].begin(), curIN[op].end());
-            break;
-          case CAT_PTR:
-            curPtOUT[selectInst].clear();
-            for (auto *op : {op1, op2})
-              curPtOUT[selectInst].insert(curPtIN[op].begin(), curPtIN[op].end());
-            break;
-          case OTHER:
-            break;
-          }
-        }
-        else if (type == ALLOCA)
+    // the calls are lowered in batches, which end at the other calls and at the end of their block: a heap object is read
+    // once per batch, and written once, when the batch ends or before a write or read of data that may alias it
+    // distinct function arguments and CAT_new only alias themselves, as the RDA assumes
+    auto isRoot = [&moduleInfo](Value *data)
+    {
+      auto *callInst = dyn_cast<CallInst>(data);
+      return isa<Argument>(data) || (callInst && moduleInfo.getApi(callInst) == API_NEW);
+    };
+    auto mayAlias = [&](Value *data, Value *other)
+    { return data == other || !isRoot(data) || !isRoot(other); };
+    for (auto &BB : F)
+    {
+      DenseMap<Value *, Value *> known;
+      MapVector<Value *, Value *> pending;
+      auto flush = [&](Instruction *before)
+      {
+        for (auto &write : pending)
+          IRBuilder<>(before).CreateCall(setDecl, {write.first, write.second});
+        heapCalls |= !pending.empty();
+        pending.clear();
+      };
+      for (auto &I : llvm::make_early_inc_range(BB))
+      {
+        auto *callInst = dyn_cast<CallInst>(&I);
+        if (!callInst || !accesses.count(callInst))
         {
-          auto *allocaInst = cast<AllocaInst>(&I);
-          if (checkType(allocaInst) == CAT_PTR)
-          {
-            resetAliasInfo(allocaInst, curAliIN, curAliOUT);
-            curPtOUT[allocaInst].clear();
-          }
-          else
-            cout << "[WARNING] In " << *allocaInst << " the ptr is not recognized\n";
+          // the other calls may read or write any heap object
+          if (!isa<CallBase>(I) || isa<DbgInfoIntrinsic>(I))
+            continue;
+          auto api = callInst ? moduleInfo.getApi(callInst) : NOT_API;
+          if (api == API_NEW || api == API_IGNORED)
+            continue;
+          flush(&I);
+          if (api != API_GET)
+            known.clear();
+          continue;
         }
-        else if (type == STORE)
+
+        IRBuilder<> builder(callInst);
+        auto flushAliases = [&](Value *data)
         {
-          auto *storeInst = cast<StoreInst>(&I);
-          auto *ptr = storeInst->getPointerOperand();
-          auto *value = storeInst->getValueOperand();
-          if (checkType(ptr) == CAT_PTR)
-            setPointTo(ptr, value, curAliIN, curPtOUT);
-          else
-            cout << "[WARNING] In " << *storeInst << " the ptr is not recognized\n";
-        }
-        else if (type == LOAD)
+          if (llvm::any_of(pending, [&](std::pair<Value *, Value *> &write)
+                           { return write.first != data && mayAlias(write.first, data); }))
+            flush(callInst);
+        };
+        auto read = [&](Value *data) -> Value *
         {
-          auto *loadInst = cast<LoadInst>(&I);
-          auto *ptr = loadInst->getPointerOperand();
-
-          if (checkType(ptr) == CAT_PTR)
-          {
-            // reset for loaded value
-            resetAliasInfo(loadInst, curAliIN, curAliOUT);
-            for (auto *pointed : curPtIN[ptr])
-            {
-              if (pointed == UNKNOWN)
-                continue;
-              for (auto *alias : curAliIN[pointed])
-              {
-                curAliOUT[loadInst].insert(alias);
-                curAliOUT[alias].insert(loadInst);
-              }
-            }
-
-            switch (checkType(loadInst))
+          if (auto *slot = slots.lookup(data))
+            return builder.CreateLoad(int64Type, slot);
+          if (BatchHeapAccesses)
+            if (auto *value = known.lookup(data))
             {
-            case CAT_DATA:
-              curOUT[loadInst].clear();
-              for (auto *pointed : curPtIN[ptr])
-                if (pointed == UNKNOWN)
-                  curOUT[loadInst].insert(UNKNOWN);
-                else if (checkType(pointed) != CAT_DATA)
-                  cout << "[WARNING] In " << *loadInst << " trying to assign invalid type to DATA\n";
-                else
-                  curOUT[loadInst].insert(curIN[pointed].begin(), curIN[pointed].end());
-              break;
-            case CAT_PTR:
-              curPtOUT[loadInst].clear();
-              for (auto *pointed : curPtIN[ptr])
-                if (pointed == UNKNOWN)
-                  curPtOUT[loadInst].insert(UNKNOWN);
-                else if (checkType(pointed) != CAT_PTR)
-                  cout << "[WARNING] In " << *loadInst << " trying to assign invalid type to PTR\n";
-                else
-                  curPtOUT[loadInst].insert(curPtIN[pointed].begin(), curPtIN[pointed].end());
-              break;
-            case OTHER:
-              break;
+              NumBatchedAccesses++;
+              return value;
             }
-            // if previously there is only UNKNOWN in curPtIN, then delegate the UNKNOWN to loaded value
-            curPtOUT[ptr].erase(UNKNOWN);
-            // add a new relationship
-            addPointTo(ptr, loadInst, curAliIN, curPtOUT);
-          }
-          else
-            cout << "[WARNING] In " << *loadInst << " the ptr is not recognized\n";
-        }
-        else if (type == BITCAST)
+          flushAliases(data);
+          heapCalls = true;
+          auto *value = builder.CreateCall(getDecl, {data});
+          known[data] = value;
+          return value;
+        };
+        auto write = [&](Value *data, Value *value)
         {
-          auto *bitcastInst = cast<BitCastInst>(&I);
-          auto *casted = bitcastInst->getOperand(0);
-          resetAliasInfo(bitcastInst, curAliIN, curAliOUT);
-          for (auto *alias : curAliIN[casted])
-          {
-            curAliOUT[bitcastInst].insert(alias);
-            curAliOUT[alias].insert(bitcastInst);
-          }
-          switch (checkType(bitcastInst))
+          if (auto *slot = slots.lookup(data))
           {
-          case CAT_DATA:
-            curOUT[bitcastInst].clear();
-            curOUT[bitcastInst].insert(curIN[casted].begin(), curIN[casted].end());
-            break;
-          case CAT_PTR:
-            curPtOUT[bitcastInst].clear();
-            curPtOUT[bitcastInst].insert(curPtIN[casted].begin(), curPtIN[casted].end());
-            break;
-          case OTHER:
-            break;
+            builder.CreateStore(value, slot);
+            return;
           }
-        }
-        else if (type == CAT_NEW)
+          flushAliases(data);
+          for (auto &entry : SmallVector<std::pair<Value *, Value *>, 8>(known.begin(), known.end()))
+            if (mayAlias(entry.first, data))
+              known.erase(entry.first);
+          if (pending.count(data))
+            NumBatchedAccesses++;
+          known[data] = value;
+          pending[data] = value;
+          if (!BatchHeapAccesses)
+            flush(callInst);
+        };
+        auto api = moduleInfo.getApi(callInst);
+        if (api == API_GET)
         {
-          auto *newInst = cast<CallInst>(&I);
-          // reset the aliasing information
-          resetAliasInfo(newInst, curAliIN, curAliOUT);
-          setDef(newInst, newInst, curAliOUT, curOUT);
+          auto *value = read(callInst->getArgOperand(0));
+          if (isa<Instruction>(value) && !value->hasName())
+            value->takeName(callInst);
+          callInst->replaceAllUsesWith(value);
         }
-        else if (type == CAT_MOD)
+        else if (api == API_SET)
+          write(callInst->getArgOperand(0), callInst->getArgOperand(1));
+        else if (api == API_ADD || api == API_SUB)
         {
-          auto *modInst = cast<CallInst>(&I);
-          Value *gen = modInst->getArgOperand(0);
-          setDef(gen, modInst, curAliOUT, curOUT);
+          auto *op1 = read(callInst->getArgOperand(1)), *op2 = read(callInst->getArgOperand(2));
+          write(callInst->getArgOperand(0), api == API_ADD ? builder.CreateAdd(op1, op2) : builder.CreateSub(op1, op2));
         }
-        else if (type == MISC_FUNC)
-        {
-          auto *callInst = cast<CallInst>(&I);
-          std::set<Value *> possibleDataPassedIn, possiblePtrPassedIn, possiblePtrModified;
+        callInst->eraseFromParent();
+      }
+      flush(BB.getTerminator());
+    }
 
-          // add globals
-          for (auto &GV : curModule->globals())
-            switch (checkType(&GV))
-            {
-            case CAT_DATA:
-              possibleDataPassedIn.insert(&GV);
-              break;
-            case OTHER:
-              break;
-            case CAT_PTR:
-              possiblePtrPassedIn.insert(&GV);
-              if (mayReferencedByFunc(callInst, &GV))
-              {
-                auto possibleCATData = findAllPossibleCATData(&GV, curPtIN);
-                possibleDataPassedIn.insert(possibleCATData.begin(), possibleCATData.end());
-              }
-              break;
-            }
+    for (auto *newInst : objects)
+      newInst->eraseFromParent();
+    PromoteMemToReg(allocas, DT, &AC);
+    NumPromotedObjects += objects.size();
+    return true;
+  }
+
+  // mark a function always-inline, return whether its attributes changed
+  bool markAlwaysInline(Function &F)
+  {
+    if (F.hasFnAttribute(llvm::Attribute::AlwaysInline) && !F.hasFnAttribute(llvm::Attribute::NoInline))
+      return false;
+    F.removeFnAttr(llvm::Attribute::NoInline);
+    F.addFnAttr(llvm::Attribute::AlwaysInline);
+    return true;
+  }
+
+  // mark a call site always-inline, which the inliners honor whatever the attributes of the callee
+  bool markAlwaysInline(CallInst &callInst)
+  {
+    if (callInst.hasFnAttr(llvm::Attribute::AlwaysInline))
+      return false;
+    callInst.addFnAttr(llvm::Attribute::AlwaysInline);
+    return true;
+  }
 
-          for (unsigned i = 0; i < callInst->getNumOperands() - 1; i++)
+  // the profile of the module, if it has one and the pass uses it
+  ProfileSummaryInfo *usedProfile(ProfileSummaryInfo &PSI)
+  {
+    return UseProfile && PSI.hasProfileSummary() ? &PSI : nullptr;
+  }
+
+  using CallSiteSet = SmallPtrSet<CallInst *, 32>;
+
+  // the calls to defined functions that the profile finds hot, the only call sites inlined in a module with a profile
+  // the block frequencies are computed only for the functions calling defined functions
+  CallSiteSet hotCallSites(Module &M, ProfileSummaryInfo &PSI, function_ref<BlockFrequencyInfo &(Function &)> getBFI)
+  {
+    CallSiteSet hot;
+    for (auto &F : M)
+    {
+      BlockFrequencyInfo *BFI = nullptr;
+      for (auto &BB : F)
+        for (auto &I : BB)
+          if (auto *callInst = dyn_cast<CallInst>(&I))
           {
-            auto *arg = callInst->getArgOperand(i);
-            switch (checkType(arg))
-            {
-            case CAT_DATA:
-              possibleDataPassedIn.insert(arg);
-              break;
-            case OTHER:
-              break;
-            case CAT_PTR:
-              possiblePtrPassedIn.insert(arg);
-              if (mayReferencedByFunc(callInst, arg))
-              {
-                auto possibleCATData = findAllPossibleCATData(arg, curPtIN);
-                possibleDataPassedIn.insert(possibleCATData.begin(), possibleCATData.end());
-              }
-              break;
-            }
+            auto *callee = callInst->getCalledFunction();
+            if (!callee || callee->isDeclaration() || callee == &F)
+              continue;
+            if (!BFI)
+              BFI = &getBFI(F);
+            if (PSI.isHotCallSite(*callInst, BFI))
+              hot.insert(callInst);
+            else
+              NumColdCallSites++;
           }
+    }
+    return hot;
+  }
 
-          for (auto *ptr : possiblePtrPassedIn)
-            if (mayModifiedByFunc(callInst, ptr))
-              possiblePtrModified.insert(ptr);
+  // the summaries of the defined functions of a module, the inlining policy built on them, and the types of its globals
+  struct ModuleSummaries
+  {
+    FunctionSummaryMap funcSummaries;
+    std::shared_ptr<const ModuleInfo> moduleInfo;
 
-          for (auto *data : possibleDataPassedIn)
-            if (data == UNKNOWN)
-              continue;
-            else if (mayModifiedByFunc(callInst, data))
-              setDef(data, UNKNOWN, curAliIN, curOUT);
+    const FunctionSummary *getFunctionSummary(Function *F)
+    {
+      return findFunctionSummary(funcSummaries, F);
+    }
 
-          // modified PTR can point to any passed in DATA
-          for (auto *ptr : possiblePtrModified)
-            for (auto *data : possibleDataPassedIn)
-              addPointTo(ptr, data, curAliIN, curPtOUT);
+    // summarize the functions of the module, callees before callers
+    void summarizeFunctions(CallGraph &CG)
+    {
+      moduleInfo = std::make_shared<ModuleInfo>(CG.getModule());
+      funcSummaries.clear();
+      for (auto it = scc_begin(&CG); !it.isAtEnd(); ++it)
+      {
+        // recursion is not summarized
+        if (it.hasCycle())
+          continue;
+        auto *F = (*it).front()->getFunction();
+        if (!F || F->isDeclaration())
+          continue;
+
+        FunctionSummary summary;
+        if (summarizeFunction(*F, summary))
+          funcSummaries[F] = summary;
+      }
+    }
 
-          // the return value can be alias of any same-level argument
-          switch (checkType(callInst))
+    bool summarizeFunction(Function &F, FunctionSummary &summary)
+    {
+      // the values stored in each stack slot of the function
+      DenseMap<Value *, SmallVector<Value *, 4>> allocaStores;
+      for (auto &BB : F)
+        for (auto &I : BB)
+          if (auto *storeInst = dyn_cast<StoreInst>(&I))
           {
-          case CAT_DATA:
-            // merge all info of possible CAT_data
-            resetAliasInfo(callInst, curAliIN, curAliOUT);
-            curOUT[callInst].clear();
+            auto *obj = getUnderlyingObject(storeInst->getPointerOperand());
+            if (isa<AllocaInst>(obj))
+              allocaStores[obj].push_back(storeInst->getValueOperand());
+            else if (storeInst->getValueOperand()->getType()->isPointerTy())
+              // the caller may see the pointer
+              return false;
+          }
+
+      std::set<Value *> modified, read, returned;
+      for (auto &BB : F)
+        for (auto &I : BB)
+        {
+          if (auto *retInst = dyn_cast<ReturnInst>(&I))
+          {
+            if (retInst->getReturnValue() && retInst->getReturnValue()->getType()->isPointerTy())
+              collectRoots(retInst->getReturnValue(), allocaStores, returned);
+            continue;
+          }
 
-            // it could be pointed by any possible CAT_ptr modified
-            for (auto *ptr : possiblePtrModified)
-              curPtOUT[ptr].insert(callInst);
+          auto *callBase = dyn_cast<CallBase>(&I);
+          if (!callBase)
+            continue;
+          auto *callInst = dyn_cast<CallInst>(callBase);
+          if (!callInst || !callInst->getCalledFunction())
+            return false;
 
-            for (auto *data : possibleDataPassedIn)
+          switch (moduleInfo->getInstType(I))
+          {
+          case CAT_MOD:
+            collectRoots(callInst->getArgOperand(0), allocaStores, modified);
+            if (moduleInfo->getApi(callInst) != API_SET)
             {
-              if (data == UNKNOWN)
-                curOUT[callInst].insert(UNKNOWN);
-              else if (AA->alias(data, getSize(data), callInst, getSize(callInst)) == AliasResult::NoAlias)
-                continue;
-              else
-              {
-                curOUT[callInst].insert(curOUT[data].begin(), curOUT[data].end());
-                mergeAliasInfo(data, callInst, curAliIN, curAliOUT);
-              }
+              collectRoots(callInst->getArgOperand(1), allocaStores, read);
+              collectRoots(callInst->getArgOperand(2), allocaStores, read);
             }
             break;
-          case CAT_PTR:
-            // merge all info of possible CAT_ptr
-            resetAliasInfo(callInst, curAliIN, curAliOUT);
-            curPtOUT[callInst].clear();
-            for (auto *ptr : possiblePtrPassedIn)
+          case CAT_GET:
+            collectRoots(callInst->getArgOperand(0), allocaStores, read);
+            break;
+          case MISC_FUNC:
+            if (auto *callee = getFunctionSummary(callInst->getCalledFunction()))
             {
-              if (AA->alias(ptr, getSize(ptr), callInst, getSize(callInst)) == AliasResult::NoAlias)
-                continue;
-              curPtOUT[callInst].insert(curPtOUT[ptr].begin(), curPtOUT[ptr].end());
-              mergeAliasInfo(ptr, callInst, curAliIN, curAliOUT);
+              for (auto i : callee->modifiedArgs)
+                collectRoots(callInst->getArgOperand(i), allocaStores, modified);
+              for (auto i : callee->readArgs)
+                collectRoots(callInst->getArgOperand(i), allocaStores, read);
+              modified.insert(callee->modifiedGlobals.begin(), callee->modifiedGlobals.end());
+              read.insert(callee->readGlobals.begin(), callee->readGlobals.end());
+              if (callee->readsUnknown)
+                read.insert(UNKNOWN);
             }
+            else
+              return false;
             break;
-          case OTHER:
+          default:
             break;
           }
         }
 
-        OUT[&I] = curOUT;
-        curIN = curOUT;
-        aliOUT[&I] = curAliOUT;
-        curAliIN = curAliOUT;
-        ptOUT[&I] = curPtOUT;
-        curPtIN = curPtOUT;
-      }
-
-      // if the block is analyzed for the first time, then we need to add its successors to the queue
-      if (firstTime)
-        return true;
+      if (modified.count(UNKNOWN) || returned.count(UNKNOWN))
+        return false;
 
-      // the block is analyzed before, so we need to compare the old OUT with the new OUT
-      for (auto &pair : OUT[BB.getTerminator()])
-        for (auto *I : pair.second)
-          newOut.insert(I);
+      for (auto *root : modified)
+        if (auto *arg = dyn_cast<Argument>(root))
+          summary.modifiedArgs.insert(arg->getArgNo());
+        else if (auto *GV = dyn_cast<GlobalVariable>(root))
+          summary.modifiedGlobals.insert(GV);
 
-      if (oldOut.size() != newOut.size())
-        return true;
+      for (auto *root : read)
+        if (root == UNKNOWN)
+          summary.readsUnknown = true;
+        else if (auto *arg = dyn_cast<Argument>(root))
+          summary.readArgs.insert(arg->getArgNo());
+        else if (auto *GV = dyn_cast<GlobalVariable>(root))
+          summary.readGlobals.insert(GV);
 
-      for (auto *I : oldOut)
-        // found a difference, so the block is changed
-        if (newOut.find(I) == newOut.end())
-          return true;
+      // the created data returned is constant if it's created with the same constant and never modified
+      bool constantKnown = true;
+      for (auto *root : returned)
+        if (auto *arg = dyn_cast<Argument>(root))
+          summary.returnedArgs.insert(arg->getArgNo());
+        else if (auto *GV = dyn_cast<GlobalVariable>(root))
+          summary.returnedGlobals.insert(GV);
+        else
+        {
+          summary.returnsFresh = true;
+          auto *constant = modified.count(root) ? nullptr : getCreatedConstant(cast<CallInst>(root));
+          if (!constant || (summary.returnConstant && summary.returnConstant->getValue() != constant->getValue()))
+            constantKnown = false;
+          summary.returnConstant = constant;
+        }
+      if (!constantKnown)
+        summary.returnConstant = nullptr;
+      return true;
+    }
 
-      // the block is not changed if the two sets are equal
-      return false;
+    // folding in the callers is blocked if the function is opaque, kills CAT data they can see,
+    // or returns created data whose value isn't known
+    bool blocksFolding(Function *F)
+    {
+      auto *summary = getFunctionSummary(F);
+      return !summary || !summary->modifiedArgs.empty() || !summary->modifiedGlobals.empty() ||
+             (summary->returnsFresh && !summary->returnConstant);
     }
 
-    void dumpRDAInfo()
+    // mark the functions to be inlined, callees before callers
+    // the size of a function includes the bodies of the callees inlined into it
+    // with a profile, only the hot call sites are marked, and the other calls neither count nor grow the module
+    bool setInliningPolicy(CallGraph &CG, const CallSiteSet *hot)
     {
-      cout << "Function \"" << curFunc->getName() << "\"\n";
+      bool modified = false;
+      std::map<Function *, unsigned> blanketSize, selectedSize;
+      std::set<Function *> selected;
+      unsigned blanketGrowth = 0, growth = 0, total = 0, markedSites = 0;
 
-      for (auto &BB : *curFunc)
-        for (auto &I : BB)
+      for (auto it = scc_begin(&CG); !it.isAtEnd(); ++it)
+        for (auto *node : *it)
         {
-          cout << "INSTRUCTION: " << I << "\n***************** RDA IN\n{\n";
-          for (auto &pair : IN[&I])
-          {
-            cout << "DEF OF " << *pair.first << ":\n";
-            for (auto *def : pair.second)
-              if (def)
-                cout << "  " << *def << "\n";
-              else
-                cout << "  UNKNOWN\n";
-          }
-          cout << "}\n**************************************\n";
+          auto *F = node->getFunction();
+          if (!F || F->isDeclaration())
+            continue;
+          total++;
 
-          cout << "***************** POINT-TO IN\n{\n";
-          for (auto &pair : ptIN[&I])
-          {
-            cout << "DEF OF " << *pair.first << ":\n";
-            for (auto *def : pair.second)
-              if (def)
-                cout << "  " << *def << "\n";
-              else
-                cout << "  UNKNOWN\n";
-          }
-          cout << "}\n**************************************\n";
+          SmallVector<CallInst *, 8> sites;
+          for (auto *U : F->users())
+            if (auto *callInst = dyn_cast<CallInst>(U))
+              if (callInst->getCalledFunction() == F && (!hot || hot->count(callInst)))
+                sites.push_back(callInst);
 
-          cout << "***************** RDA OUT\n{\n";
-          for (auto &pair : OUT[&I])
-          {
-            cout << "DEF OF " << *pair.first << ":\n";
-            for (auto *def : pair.second)
-              if (def)
-                cout << "  " << *def << "\n";
-              else
-                cout << "  UNKNOWN\n";
-          }
-          cout << "}\n**************************************\n";
+          blanketSize[F] = selectedSize[F] = F->getInstructionCount();
+          for (auto &BB : *F)
+            for (auto &I : BB)
+              if (auto *callInst = dyn_cast<CallInst>(&I))
+              {
+                auto *callee = callInst->getCalledFunction();
+                if (blanketSize.count(callee) && callee != F)
+                  blanketSize[F] += blanketSize[callee] - 1;
+                if (selected.count(callee) && (!hot || hot->count(callInst)))
+                  selectedSize[F] += selectedSize[callee] - 1;
+              }
 
-          cout << "***************** POINT-TO OUT\n{\n";
-          for (auto &pair : ptOUT[&I])
-          {
-            cout << "DEF OF " << *pair.first << ":\n";
-            for (auto *def : pair.second)
-              if (def)
-                cout << "  " << *def << "\n";
-              else
-                cout << "  UNKNOWN\n";
-          }
-          cout << "}\n**************************************\n";
+          // recursive functions can't be inlined
+          if (it.hasCycle() || sites.empty())
+            continue;
+          blanketGrowth += sites.size() * (blanketSize[F] - 1);
+
+          unsigned cost = sites.size() * (selectedSize[F] - 1);
+          if (!blocksFolding(F) || selectedSize[F] > InlineCalleeSize || growth + cost > InlineBudget)
+            continue;
+          selected.insert(F);
+          growth += cost;
+          markedSites += sites.size();
+
+          if (!hot)
+            modified |= markAlwaysInline(*F);
+          else
+            for (auto *callInst : sites)
+              modified |= markAlwaysInline(*callInst);
         }
+
+      if (ReportInlining)
+      {
+        cout << "[INLINE] " << selected.size() << " of " << total << " functions marked always-inline";
+        if (hot)
+          cout << " at " << markedSites << " hot call sites";
+        cout << ", estimated growth " << growth << " instructions, " << blanketGrowth - growth << " avoided\n";
+      }
+      return modified;
     }
 
-    void dumpTypeInfo()
+    // the value of the CAT data created by a CAT_new or a summarized function, if it's a constant
+    ConstantInt *getCreatedConstant(CallInst *callInst)
     {
-      cout << "Function \"" << curFunc->getName() << "\"\n";
-      cout << "CAT data:\n";
-      for (auto *v : allCATData)
-        cout << "  " << *v << "\n";
-      cout << "CAT pointers:\n";
-      for (auto *v : allCATPtr)
-        cout << "  " << *v << "\n";
+      if (moduleInfo->getApi(callInst) == API_NEW)
+        return dyn_cast<ConstantInt>(callInst->getArgOperand(0));
+      auto *summary = getFunctionSummary(callInst->getCalledFunction());
+      return summary ? summary->returnConstant : nullptr;
     }
 
-    ConstantInt *getIfIsConstant(Value *operand, RDASet &curIN)
+    // find where a CAT value of the function being summarized may come from
+    // roots are arguments, globals, and the calls creating CAT data inside the function, or UNKNOWN
+    void collectRoots(Value *v, DenseMap<Value *, SmallVector<Value *, 4>> &allocaStores, std::set<Value *> &roots)
     {
-      ConstantInt *constant = nullptr;
-
-      for (auto *def : curIN[operand])
+      SmallPtrSet<Value *, 16> visited;
+      SmallVector<Value *, 16> worklist = {v};
+      while (!worklist.empty())
       {
-        // def may be UNKNOWN, which means the operand may be defined outside the function
-        if (def == UNKNOWN)
-          return nullptr;
-
-        if (deleteMap.find(def) != deleteMap.end())
-          def = deleteMap[def];
+        auto *cur = worklist.pop_back_val();
+        if (!visited.insert(cur).second)
+          continue;
 
-        Value *candidate = nullptr;
-        if (auto *callInst = dyn_cast<CallInst>(def))
+        if (isa<Argument>(cur) || isa<GlobalVariable>(cur))
+          roots.insert(cur);
+        else if (isa<ConstantPointerNull>(cur) || isa<UndefValue>(cur))
+          continue;
+        else if (auto *phiNode = dyn_cast<PHINode>(cur))
+          worklist.append(phiNode->op_begin(), phiNode->op_end());
+        else if (auto *selectInst = dyn_cast<SelectInst>(cur))
         {
-          auto calledName = callInst->getCalledFunction()->getName();
-          if (calledName.equals("CAT_new"))
-            candidate = callInst->getOperand(0);
-          else if (calledName.equals("CAT_set"))
-            candidate = callInst->getOperand(1);
+          worklist.push_back(selectInst->getTrueValue());
+          worklist.push_back(selectInst->getFalseValue());
+        }
+        else if (auto *castInst = dyn_cast<BitCastInst>(cur))
+          worklist.push_back(castInst->getOperand(0));
+        else if (auto *loadInst = dyn_cast<LoadInst>(cur))
+        {
+          // only the stack slots of the function are known
+          auto *obj = getUnderlyingObject(loadInst->getPointerOperand());
+          if (isa<AllocaInst>(obj))
+            worklist.append(allocaStores[obj].begin(), allocaStores[obj].end());
+          else
+            roots.insert(UNKNOWN);
+        }
+        else if (auto *callInst = dyn_cast<CallInst>(cur))
+        {
+          auto *summary = getFunctionSummary(callInst->getCalledFunction());
+          if (moduleInfo->getApi(callInst) == API_NEW)
+            roots.insert(callInst);
+          else if (summary)
+          {
+            for (auto i : summary->returnedArgs)
+              worklist.push_back(callInst->getArgOperand(i));
+            roots.insert(summary->returnedGlobals.begin(), summary->returnedGlobals.end());
+            if (summary->returnsFresh)
+              roots.insert(callInst);
+          }
           else
-            // CAT_add, CAT_sub, or passed into functions
-            candidate = nullptr;
+            roots.insert(UNKNOWN);
         }
+        else
+          roots.insert(UNKNOWN);
+      }
+    }
 
-        if (propMap.find(candidate) != propMap.end())
-          candidate = propMap[candidate];
+  };
 
-        if (!candidate || !isa<ConstantInt>(candidate))
-          return nullptr;
+  // unroll and peel the loops that use CAT APIs, shared by both pass managers
+  struct LoopTransforms
+  {
+    static bool containsCATApi(Loop *loop, const ModuleInfo &moduleInfo)
+    {
+      for (auto *BB : loop->getBlocks())
+        for (auto &I : *BB)
+          if (auto callInst = dyn_cast<CallInst>(&I))
+          {
+            auto api = moduleInfo.getApi(callInst);
+            if (api != NOT_API && api != API_IGNORED)
+              return true;
+          }
+      return false;
+    }
 
-        if (!constant)
-          constant = cast<ConstantInt>(candidate);
-        else if (constant->getValue() != cast<ConstantInt>(candidate)->getValue())
-          return nullptr;
-      }
+    // the transformations already applied to a loop, kept in its metadata so that the later rounds and runs of the pass see them
+    static constexpr const char *PeeledCountMD = "llvm.loop.cat.peeled.count";
+    static constexpr const char *UnrolledMD = "llvm.loop.cat.unrolled";
 
-      return constant;
+    static unsigned peeledCount(const Loop *loop)
+    {
+      return getOptionalIntLoopAttribute(loop, PeeledCountMD).getValueOr(0);
     }
 
-    bool constantFoldAndAlgSimp()
+    // also honors the unrolling pragmas of the loop
+    static bool mayUnroll(const Loop *loop)
     {
-      if (!curModule->getFunction("CAT_set"))
-        return false;
-
-      std::vector<CallInst *> deleteList;
-      std::vector<CallInst *> instructions;
-      for (auto &B : curFunc->getBasicBlockList())
-        for (auto &I : B)
-        {
+      return !getBooleanLoopAttribute(loop, UnrolledMD) && !(hasUnrollTransformation(loop) & TM_Disable);
+    }
 
-          if (!isa<CallInst>(I))
-            continue;
+    static int countLoopInstructions(Loop *loop)
+    {
+      int count = 0;
+      for (auto *BB : loop->getBlocks())
+        count += BB->size();
+      return count;
+    }
 
-          auto *callInst = cast<CallInst>(&I);
-          auto calledName = callInst->getCalledFunction()->getName();
+    // the CAT reads of a loop that peeling or unrolling lets constant propagation remove
+    // a read is carried when the data it reads is written in the loop, but not before it in the same iteration
+    struct CATLoopProfile
+    {
+      // carried reads: the peeled iterations only see the data from before the loop
+      unsigned carried = 0;
+      // carried reads of data the loop writes with an invariant value: they fold in every unrolled copy but the first
+      SmallVector<CallInst *, 8> invariant;
+    };
 
-          if (!(calledName.equals("CAT_add") || calledName.equals("CAT_sub")))
+    static CATLoopProfile profileLoop(Loop *loop, const ModuleInfo &moduleInfo, DominatorTree &DT)
+    {
+      DenseMap<Value *, SmallVector<CallInst *, 2>> writes;
+      SmallVector<std::pair<CallInst *, Value *>, 16> reads;
+      for (auto *BB : loop->getBlocks())
+        for (auto &I : *BB)
+        {
+          auto callInst = dyn_cast<CallInst>(&I);
+          if (!callInst)
             continue;
-          instructions.push_back(callInst);
+          switch (moduleInfo.getApi(callInst))
+          {
+          case API_GET:
+            reads.push_back({callInst, callInst->getArgOperand(0)});
+            break;
+          case API_ADD:
+          case API_SUB:
+            reads.push_back({callInst, callInst->getArgOperand(1)});
+            reads.push_back({callInst, callInst->getArgOperand(2)});
+            writes[callInst->getArgOperand(0)].push_back(callInst);
+            break;
+          case API_SET:
+            writes[callInst->getArgOperand(0)].push_back(callInst);
+            break;
+          case NOT_API:
+            // unknown code may write the data it is given
+            for (auto &arg : callInst->args())
+              if (arg->getType()->isPointerTy())
+                writes[arg].push_back(callInst);
+            break;
+          default:
+            break;
+          }
+        }
+
+      // a write is invariant when it stores the same value at every iteration
+      auto isInvariant = [&](CallInst *write)
+      {
+        switch (moduleInfo.getApi(write))
+        {
+        case API_SET:
+          return loop->isLoopInvariant(write->getArgOperand(1));
+        case API_ADD:
+        case API_SUB:
+          return !writes.count(write->getArgOperand(1)) && !writes.count(write->getArgOperand(2));
+        default:
+          return false;
         }
+      };
+
+      CATLoopProfile profile;
+      for (auto [read, data] : reads)
+      {
+        auto found = writes.find(data);
+        if (found == writes.end())
+          continue;
+        auto &dataWrites = found->second;
+        if (llvm::any_of(dataWrites, [&](CallInst *write)
+                         { return write != read && DT.dominates(write, read); }))
+          continue;
+        profile.carried++;
+        if (llvm::all_of(dataWrites, isInvariant))
+          profile.invariant.push_back(read);
+      }
+      return profile;
+    }
+
+    enum LoopAction
+    {
+      LOOP_KEEP,
+      LOOP_PEEL,
+      LOOP_UNROLL,
+      LOOP_RUNTIME_UNROLL,
+      LOOP_FULL_UNROLL,
+    };
+
+    struct LoopPlan
+    {
+      LoopAction action = LOOP_KEEP;
+      unsigned count = 0;
+      unsigned size = 0;
+      unsigned tripCount = 0;
+      bool overBudget = false;
+    };
+
+    // choose how to transform a loop, weighing the code each unroll factor adds, as TTI estimates it, against the CAT reads
+    // it lets constant propagation remove
+    static LoopPlan planLoop(Loop *loop, const CATLoopProfile &profile, ScalarEvolution &SE, AssumptionCache &AC,
+                             OptimizationRemarkEmitter &ORE, const TargetTransformInfo &TTI, ProfileSummaryInfo *PSI,
+                             BlockFrequencyInfo *BFI)
+    {
+      LoopPlan plan;
+      if (!profile.carried || hasDisableAllTransformsHint(loop))
+        return plan;
+
+      // the thresholds of -O2, which -unroll-threshold and the other unrolling options of LLVM override
+      auto UP = gatherUnrollingPreferences(loop, SE, TTI, BFI, PSI, ORE, 2, None, None, None, None, None, None);
+      SmallPtrSet<const Value *, 32> ephValues;
+      CodeMetrics::collectEphemeralValues(loop, &AC, ephValues);
+      unsigned numCalls;
+      bool notDuplicatable, convergent;
+      plan.size = ApproximateLoopSize(loop, numCalls, notDuplicatable, convergent, TTI, ephValues, UP.BEInsns);
+      if (notDuplicatable || convergent)
+        return plan;
+      plan.tripCount = SE.getSmallConstantTripCount(loop);
+      unsigned tripMultiple = SE.getSmallConstantTripMultiple(loop);
+      uint64_t body = plan.size - UP.BEInsns;
 
-      for (auto *callInst : instructions)
+      // the code saved in each copy where the invariant reads fold
+      uint64_t saving = 0;
+      for (auto *read : profile.invariant)
       {
-        auto calledName = callInst->getCalledFunction()->getName();
-        IRBuilder<> builder(callInst);
-        Value *newOperand;
-
-        // check if all the definitions of the operands that reach the call instruction are constant
-        auto op1 = callInst->getOperand(1);
-        auto op2 = callInst->getOperand(2);
+        auto cost = TTI.getUserCost(read, TargetTransformInfo::TCK_CodeSize);
+        saving += cost.isValid() ? *cost.getValue() : 1;
+      }
+      saving = std::min(saving, body - 1);
 
-        // algebraic simplification of sub: x - x = 0
-        if (calledName.equals("CAT_sub") && op1 == op2)
+      if (!profile.invariant.empty() && mayUnroll(loop))
+      {
+        if (plan.tripCount && plan.tripCount <= UP.FullUnrollMaxCount && plan.tripCount * (body - saving) + saving <= UP.Threshold)
         {
-          newOperand = ConstantInt::get(Type::getInt64Ty(curFunc->getContext()), 0);
-          deleteMap[callInst] = builder.CreateCall(curModule->getFunction("CAT_set"), std::vector<Value *>({callInst->getOperand(0), newOperand}));
-          deleteList.push_back(callInst);
-          continue;
+          plan.action = LOOP_FULL_UNROLL;
+          plan.count = plan.tripCount;
+          return plan;
         }
 
-        // check the constantness of the operands
-        auto *constant1 = getIfIsConstant(op1, IN[callInst]), *constant2 = getIfIsConstant(op2, IN[callInst]);
-        if (!constant1 && !constant2)
-          continue;
-
-        // if both operands are constant, constant fold
-        if (constant1 && constant2)
-          newOperand = calledName.equals("CAT_add") ? builder.CreateAdd(constant1, constant2) : builder.CreateSub(constant1, constant2);
-        // if one of the operands is constant 0, then we can do the algebraic simplification
-        else if (!constant1 && isa<ConstantInt>(constant2) && cast<ConstantInt>(constant2)->getValue() == 0)
-          newOperand = builder.CreateCall(curModule->getFunction("CAT_get"), std::vector<Value *>({op1}));
-        else if (!constant2 && isa<ConstantInt>(constant1) && cast<ConstantInt>(constant1)->getValue() == 0 && calledName.equals("CAT_add"))
-          // if the operation is CAT_sub and the second operand is not constant, then we can't simplify it because we need to do negation
-          newOperand = builder.CreateCall(curModule->getFunction("CAT_get"), std::vector<Value *>({op2}));
-        else
-          continue;
-
-        deleteMap[callInst] = builder.CreateCall(curModule->getFunction("CAT_set"), std::vector<Value *>({callInst->getOperand(0), newOperand}));
-        deleteList.push_back(callInst);
+        // the largest power of two that fits, with a remainder loop when it doesn't divide the trip count
+        bool runtime = !isa<SCEVCouldNotCompute>(SE.getBackedgeTakenCount(loop));
+        unsigned limit = std::min(UP.MaxCount, plan.tripCount ? plan.tripCount - 1 : UINT_MAX);
+        for (uint64_t count = 2; count <= limit; count *= 2)
+        {
+          bool remainder = tripMultiple % count != 0;
+          uint64_t unrolledSize = count * (body - saving) + saving + UP.BEInsns + (remainder && runtime ? plan.size : 0);
+          if (unrolledSize > UP.PartialThreshold)
+            break;
+          plan.action = remainder && runtime ? LOOP_RUNTIME_UNROLL : LOOP_UNROLL;
+          plan.count = count;
+        }
+        if (plan.action != LOOP_KEEP)
+          return plan;
       }
-      for (auto *I : deleteList)
-        I->eraseFromParent();
 
-      return deleteList.size() > 0;
+      // the carried reads fold in the peeled iterations
+      auto PP = gatherPeelingPreferences(loop, SE, TTI, None, None);
+      unsigned peeled = peeledCount(loop);
+      unsigned peelCount = peeled < MaxPeelCount ? MaxPeelCount - peeled : 0;
+      peelCount = std::min(peelCount, plan.tripCount ? plan.tripCount - 1 : UINT_MAX);
+      while (peelCount && peelCount * plan.size > UP.Threshold)
+        peelCount--;
+      if (PP.AllowPeeling && peelCount && canPeel(loop))
+      {
+        plan.action = LOOP_PEEL;
+        plan.count = peelCount;
+      }
+      return plan;
     }
 
-    bool constantProp()
+    // the instructions a plan adds to the function, given the instructions of the loop
+    static uint64_t estimateGrowth(const LoopPlan &plan, uint64_t instructions)
     {
-      std::vector<CallInst *> deleteList;
-      std::vector<CallInst *> instructions;
-      for (auto &B : curFunc->getBasicBlockList())
-        for (auto &I : B)
-        {
-          if (!isa<CallInst>(I))
-            continue;
-          auto *callInst = cast<CallInst>(&I);
-          auto calledName = callInst->getCalledFunction()->getName();
-
-          if (!calledName.equals("CAT_get"))
-            continue;
-          instructions.push_back(callInst);
-        }
-
-      for (auto *callInst : instructions)
+      switch (plan.action)
       {
-        auto *constant = getIfIsConstant(callInst->getOperand(0), IN[callInst]);
-        if (!constant)
-          continue;
-
-        callInst->replaceAllUsesWith(constant);
-        deleteList.push_back(callInst);
-        propMap[callInst] = constant;
+      case LOOP_PEEL:
+        return plan.count * instructions;
+      case LOOP_UNROLL:
+      case LOOP_FULL_UNROLL:
+        return (plan.count - 1) * instructions;
+      case LOOP_RUNTIME_UNROLL:
+        // the remainder loop is one more copy
+        return plan.count * instructions;
+      default:
+        return 0;
       }
+    }
 
-      for (auto I : deleteList)
-        I->eraseFromParent();
+    static bool applyPlan(LoopInfo &LI, Loop *loop, const LoopPlan &plan, DominatorTree &DT, ScalarEvolution &SE, AssumptionCache &AC,
+                          OptimizationRemarkEmitter &ORE, const TargetTransformInfo &TTI)
+    {
+      if (plan.action == LOOP_PEEL)
+      {
+        unsigned peeled = peeledCount(loop);
+        if (!peelLoop(loop, plan.count, &LI, &SE, DT, &AC, true))
+          return false;
+        addStringMetadataToLoop(loop, PeeledCountMD, peeled + plan.count);
+        NumLoopsPeeled++;
+        return true;
+      }
 
-      return deleteList.size() > 0;
+      UnrollLoopOptions ULO;
+      ULO.Count = plan.count;
+      ULO.Force = false;
+      ULO.Runtime = plan.action == LOOP_RUNTIME_UNROLL;
+      ULO.AllowExpensiveTripCount = true;
+      ULO.UnrollRemainder = false;
+      ULO.ForgetAllSCEV = true;
+      auto unrolled = UnrollLoop(loop, ULO, &LI, &SE, &DT, &AC, &TTI, &ORE, true);
+      // without a remainder loop, each unrolled copy keeps the exit test of the loop
+      if (unrolled == LoopUnrollResult::Unmodified && ULO.Runtime)
+      {
+        ULO.Runtime = false;
+        unrolled = UnrollLoop(loop, ULO, &LI, &SE, &DT, &AC, &TTI, &ORE, true);
+      }
+      if (unrolled == LoopUnrollResult::Unmodified)
+        return false;
+      if (unrolled == LoopUnrollResult::PartiallyUnrolled)
+        addStringMetadataToLoop(loop, UnrolledMD, 1);
+      NumLoopsUnrolled++;
+      NumLoopsFullyUnrolled += unrolled == LoopUnrollResult::FullyUnrolled;
+      NumLoopsRuntimeUnrolled += ULO.Runtime;
+      return true;
     }
 
-    void RDA()
+    static void reportPlan(StringRef function, StringRef header, const CATLoopProfile &profile, const LoopPlan &plan, bool applied)
     {
-      std::queue<BasicBlock *> toBeAnalyzed;
+      static const char *actions[] = {"kept", "peeled", "unrolled", "unrolled with a remainder", "fully unrolled"};
+      cout << "[LOOP] function \"" << function << "\", loop \"" << header << "\": ";
+      if (!profile.carried)
+      {
+        cout << "no carried CAT reads, kept\n";
+        return;
+      }
+      cout << "size " << plan.size << ", trip count " << plan.tripCount << ", " << profile.carried << " carried CAT reads, "
+           << profile.invariant.size() << " invariant: " << actions[plan.action];
+      if (plan.action != LOOP_KEEP)
+        cout << " by " << plan.count << (plan.overBudget ? " (over the budget)" : applied ? "" : " (failed)");
+      cout << "\n";
+    }
 
-      // initialize the queue with all the blocks without predecessors
-      for (auto &B : *curFunc)
-        if (predecessors(&B).empty())
-          toBeAnalyzed.push(&B);
+    // transform the inner loops first, so the plan of a loop accounts for the code its unrolled inner loops added
+    // with a profile (PSI isn't null), only the hot loops are transformed
+    static bool transformLoopNest(Loop *loop, uint64_t &budget, bool &plannedLoops, const ModuleInfo &moduleInfo, LoopInfo &LI, DominatorTree &DT,
+                                  ScalarEvolution &SE, AssumptionCache &AC, OptimizationRemarkEmitter &ORE, const TargetTransformInfo &TTI,
+                                  ProfileSummaryInfo *PSI, BlockFrequencyInfo *BFI, const SmallPtrSetImpl<Loop *> &hotLoops)
+    {
+      bool changed = false;
+      std::vector<Loop *> subLoops(loop->begin(), loop->end());
+      for (auto *subLoop : subLoops)
+        changed |= transformLoopNest(subLoop, budget, plannedLoops, moduleInfo, LI, DT, SE, AC, ORE, TTI, PSI, BFI, hotLoops);
 
-      while (!toBeAnalyzed.empty())
+      unsigned instructions = countLoopInstructions(loop);
+      if (instructions > LoopSizeLimit || !containsCATApi(loop, moduleInfo) || !loop->isLoopSimplifyForm() || !loop->isLCSSAForm(DT))
+        return changed;
+      // the loop is gone once fully unrolled
+      auto *F = loop->getHeader()->getParent();
+      std::string header = loop->getHeader()->getName().str();
+      if (PSI && !hotLoops.count(loop))
       {
-        auto *BB = toBeAnalyzed.front();
-        toBeAnalyzed.pop();
-
-        // try to analyze the block
-        // if the block is changed, add its successors to the queue
-        if (RDAinBB(*BB))
-          for (auto *suc : successors(BB))
-            toBeAnalyzed.push(suc);
+        NumColdLoops++;
+        if (ReportLoops)
+          cout << "[LOOP] function \"" << F->getName() << "\", loop \"" << header << "\": cold, kept\n";
+        return changed;
       }
+      // the plan depends on the unrolling and peeling preferences of LLVM and on the budget left
+      plannedLoops = true;
+      auto profile = profileLoop(loop, moduleInfo, DT);
+      auto plan = planLoop(loop, profile, SE, AC, ORE, TTI, PSI, BFI);
+      uint64_t growth = estimateGrowth(plan, instructions);
+      plan.overBudget = growth > budget;
+      NumLoopsOverBudget += plan.overBudget;
+      bool applied = plan.action != LOOP_KEEP && !plan.overBudget && applyPlan(LI, loop, plan, DT, SE, AC, ORE, TTI);
+      if (applied)
+        budget -= growth;
+      if (ReportLoops)
+        reportPlan(F->getName(), header, profile, plan, applied);
+      return changed | applied;
     }
 
     // use unroll and peel to optimize loops
-    bool transformLoops()
+    // the loops larger than -cat-loop-size-limit are left alone, and budget is the code the transformations may still add to
+    // the module; plannedLoops is set if a loop of F is planned, whatever the plan
+    // in a module with a profile, PSI and BFI aren't null and the cold loops are left alone too
+    static bool transformLoops(Function &F, uint64_t &budget, bool &plannedLoops, const ModuleInfo &moduleInfo, LoopInfo &LI, DominatorTree &DT,
+                               ScalarEvolution &SE, AssumptionCache &AC, const TargetTransformInfo &TTI, ProfileSummaryInfo *PSI,
+                               BlockFrequencyInfo *BFI)
     {
       bool changed = false;
-      // only handle loops in function with less than 500 instructions
-      if (curFunc->getInstructionCount() >= 500)
-        return false;
-      auto &LI = getAnalysis<LoopInfoWrapperPass>(*curFunc).getLoopInfo();
-      auto &DT = getAnalysis<DominatorTreeWrapperPass>(*curFunc).getDomTree();
-      auto &SE = getAnalysis<ScalarEvolutionWrapperPass>(*curFunc).getSE();
-      auto &AC = getAnalysis<AssumptionCacheTracker>().getAssumptionCache(*curFunc);
-      const auto &TTI = getAnalysis<TargetTransformInfoWrapperPass>().getTTI(*curFunc);
-      OptimizationRemarkEmitter ORE(curFunc);
-
-      std::set<Loop *> loops;
-      // create a set of loops that contain CAT APIs
-      for (auto L : LI)
-      {
-        if (!containsCATApi(L))
-          continue;
-        loops.insert(L);
-      }
+      OptimizationRemarkEmitter ORE(&F);
 
-      if (!peeled())
-        for (auto loop : loops)
-          changed |= loopPeel(LI, loop, DT, SE, AC);
-      else
-        for (auto loop : loops)
-          changed |= loopUnroll(LI, loop, DT, SE, AC, ORE, TTI);
+      auto timer = timePhase(&PhaseTimers::loops);
+      // the frequencies don't follow the transformations, so the loops are classified before any of them, and the loops
+      // the transformations create wait for the next round
+      SmallPtrSet<Loop *, 8> hotLoops;
+      if (PSI)
+        for (auto *loop : LI.getLoopsInPreorder())
+          if (PSI->isHotBlock(loop->getHeader(), BFI))
+            hotLoops.insert(loop);
+
+      std::vector<Loop *> loops(LI.begin(), LI.end());
+      for (auto *loop : loops)
+        changed |= transformLoopNest(loop, budget, plannedLoops, moduleInfo, LI, DT, SE, AC, ORE, TTI, PSI, BFI, hotLoops);
 
       return changed;
     }
+  };
+
+  // mark the functions to be inlined after the pass, according to the inlining policy
+  // in a module with a profile, hot holds the hot call sites, and only those are marked
+  bool markInlining(Module &M, CallGraph &CG, ModuleSummaries &summaries, const CallSiteSet *hot)
+  {
+    bool modified = false;
+    if (InlinePolicy == INLINE_SELECTIVE)
+      return summaries.setInliningPolicy(CG, hot);
 
-    bool containsCATApi(Loop *loop)
+    if (hot)
     {
-      for (auto *BB : loop->getBlocks())
-        for (auto &I : *BB)
-          if (auto callInst = dyn_cast<CallInst>(&I))
-          {
-            auto calledName = callInst->getCalledFunction()->getName();
-            if (catApis.find(calledName.str()) != catApis.end())
-              return true;
-          }
-      return false;
+      for (auto *callInst : *hot)
+        modified |= markAlwaysInline(*callInst);
+      return modified;
     }
+    for (auto &F : M)
+      if (!F.isDeclaration())
+        modified |= markAlwaysInline(F);
+    return modified;
+  }
 
-    bool peeled()
+  // the functions worth optimizing: the defined ones that are called, and main
+  // the definitions ThinLTO imports from other modules are available externally: they are summarized, so the calls to them
+  // can be folded, but they are discarded after the optimizations, and their own module transforms them
+  std::vector<Function *> functionsToOptimize(Module &M)
+  {
+    std::vector<Function *> functions;
+    for (auto &F : M)
     {
-      for (auto &BB : *curFunc)
-        if (BB.getName().contains("peel"))
-          return true;
-      return false;
+      if (F.isDeclaration() || F.hasAvailableExternallyLinkage())
+        continue;
+      else if ((F.getNumUses() == 0) && (&F != M.getFunction("main")))
+        continue;
+      functions.push_back(&F);
     }
+    return functions;
+  }
 
-    int countLoopInstructions(Loop *loop)
+  // the attributes of a function or a call site, whose attribute groups are numbered for the whole module
+  void printAttributes(raw_ostream &OS, AttributeList attrs, unsigned numArgs)
+  {
+    OS << "{" << attrs.getFnAttrs().getAsString() << "}{" << attrs.getRetAttrs().getAsString() << "}";
+    for (unsigned i = 0; i < numArgs; i++)
+      OS << "{" << attrs.getParamAttrs(i).getAsString() << "}";
+  }
+
+  // on-disk cache of the functions the pass leaves unchanged, shared by the compilations using the same directory
+  // an entry is keyed by a hash of the IR of a function and of what its analysis depends on: the summaries and attributes of
+  // its callees, the CAT globals of the module, the profile and the options of the pass
+  // the functions found in the cache are skipped without type inference nor RDA; skipping a function is always correct, but
+  // a dependency the key misses would make the output depend on the earlier compilations
+  // the plans of the loops depend on the unrolling and peeling preferences of LLVM, which the options of opt and the target
+  // change, and on the loop budget, which all the functions of a module spend, so the functions with planned loops are
+  // never recorded
+  class AnalysisCache
+  {
+  public:
+    AnalysisCache(Module &M, const ModuleSummaries &summaries, ProfileSummaryInfo *PSI) : summaries(summaries)
     {
-      int count = 0;
-      for (auto *BB : loop->getBlocks())
-        count += BB->size();
-      return count;
+      // the reports and the diagnostics need the analysis of every function
+      if (CacheDir.empty() || VerifyRDA || ReportIterations || ReportLoops || !DiagnosticsFile.empty())
+        return;
+      enabled = true;
+
+      raw_string_ostream OS(moduleKey);
+      OS << "cat-cache-1;" << M.getTargetTriple() << ";" << M.getDataLayoutStr() << ";";
+      OS << UseFunctionSummaries << MaxPeelCount << "," << LoopRounds << "," << LoopSizeLimit << "," << LoopGrowthBudget << ","
+         << EliminateRedundantCalls << HoistInvariants << EliminateDeadCode << ScalarReplacement << BatchHeapAccesses << ";";
+      if (PSI)
+        OS << "profile " << PSI->getOrCompHotCountThreshold() << ";";
+      for (auto *GV : summaries.moduleInfo->catGlobals)
+        OS << GV->getName() << " " << *GV->getValueType() << " " << GV->getLinkage() << GV->isConstant() << ";";
+    }
+
+    // whether the pass left F unchanged the last time it saw the same IR
+    bool isUnchanged(Function &F)
+    {
+      if (!enabled)
+        return false;
+      auto timer = timePhase(&PhaseTimers::cache);
+      auto &key = keys[&F] = hashFunction(F);
+      if (!sys::fs::exists(entryPath(key)))
+        return false;
+      NumCachedFunctions++;
+      return true;
     }
 
-    bool loopUnroll(
-        LoopInfo &LI,
-        Loop *loop,
-        DominatorTree &DT,
-        ScalarEvolution &SE,
-        AssumptionCache &AC,
-        OptimizationRemarkEmitter &ORE,
-        const TargetTransformInfo &TTI)
+    // record that the pass left F unchanged, once isUnchanged missed it, and without planning its loops
+    // the entry is written under a temporary name, so concurrent compilations never see it partially written
+    void recordUnchanged(Function &F)
     {
-      if (loop->isLoopSimplifyForm() && loop->isLCSSAForm(DT))
+      auto it = keys.find(&F);
+      if (it == keys.end())
+        return;
+      auto timer = timePhase(&PhaseTimers::cache);
+      auto path = entryPath(it->second);
+      int fd;
+      SmallString<128> temp;
+      std::error_code EC = sys::fs::create_directories(CacheDir);
+      if (!EC)
+        EC = sys::fs::createUniqueFile(path + "-%%%%%%", fd, temp);
+      if (!EC)
       {
-        UnrollLoopOptions ULO;
-        ULO.Count = 4;
-        ULO.Force = false;
-        ULO.Runtime = false;
-        ULO.AllowExpensiveTripCount = true;
-        ULO.UnrollRemainder = false;
-        ULO.ForgetAllSCEV = true;
-        auto unrolled = UnrollLoop(loop, ULO, &LI, &SE, &DT, &AC, &TTI, &ORE, true);
-        if (unrolled != LoopUnrollResult::Unmodified)
-          return true;
+        raw_fd_ostream OS(fd, true);
+        OS << F.getName() << "\n";
       }
+      if (!EC)
+        EC = sys::fs::rename(temp, path);
+      if (EC && !warned)
+      {
+        cout << "[WARNING] can't write the analysis cache in " << CacheDir << ": " << EC.message() << "\n";
+        warned = true;
+      }
+      keys.erase(it);
+    }
 
-      auto subLoops = loop->getSubLoops();
-      for (auto j : subLoops)
-        if (loopUnroll(LI, j, DT, SE, AC, ORE, TTI))
-          return true;
+  private:
+    SmallString<32> hashFunction(Function &F)
+    {
+      std::string text;
+      raw_string_ostream OS(text);
+      OS << *F.getFunctionType();
+      printAttributes(OS, F.getAttributes(), F.arg_size());
+      if (auto count = F.getEntryCount())
+        OS << " entry " << count->getCount();
+      OS << "\n";
 
-      return false;
+      ModuleSlotTracker MST(F.getParent(), false);
+      MST.incorporateFunction(F);
+      std::string inst;
+      raw_string_ostream instOS(inst);
+      for (auto &BB : F)
+      {
+        OS << "block\n";
+        for (auto &I : BB)
+        {
+          inst.clear();
+          I.print(instOS, MST);
+          printWithoutSlots(OS, instOS.str());
+          // the branch weights of the profile are metadata
+          if (auto *prof = I.getMetadata(LLVMContext::MD_prof))
+            for (auto &op : prof->operands())
+            {
+              if (auto *name = dyn_cast<MDString>(op.get()))
+                OS << " " << name->getString();
+              else if (auto *weight = mdconst::dyn_extract<ConstantInt>(op.get()))
+                OS << " " << weight->getValue();
+            }
+          if (auto *callBase = dyn_cast<CallBase>(&I))
+          {
+            printAttributes(OS, callBase->getAttributes(), callBase->arg_size());
+            if (auto *callee = callBase->getCalledFunction())
+              printCallee(OS, *callee);
+          }
+          OS << "\n";
+        }
+      }
+
+      MD5 hash;
+      hash.update(moduleKey);
+      hash.update(OS.str());
+      MD5::MD5Result result;
+      hash.final(result);
+      return result.digest();
+    }
+
+    // what alias analysis and the summaries tell the callers of a function
+    void printCallee(raw_ostream &OS, Function &callee)
+    {
+      printAttributes(OS, callee.getAttributes(), callee.arg_size());
+      OS << (callee.isDeclaration() ? " declared" : " defined");
+      auto *summary = findFunctionSummary(summaries.funcSummaries, &callee);
+      if (!summary)
+        return;
+      OS << " summary";
+      for (auto &args : {std::make_pair("m", &summary->modifiedArgs), std::make_pair("r", &summary->readArgs),
+                         std::make_pair("ret", &summary->returnedArgs)})
+        for (auto i : *args.second)
+          OS << " " << args.first << i;
+      for (auto &globals : {std::make_pair("M", &summary->modifiedGlobals), std::make_pair("R", &summary->readGlobals),
+                            std::make_pair("RET", &summary->returnedGlobals)})
+        for (auto *GV : *globals.second)
+          OS << " " << globals.first << GV->getName();
+      OS << " " << summary->readsUnknown << summary->returnsFresh;
+      if (summary->returnConstant)
+        OS << " " << summary->returnConstant->getValue();
+    }
+
+    // the IR of an instruction without the numbers of its metadata and attribute groups, which depend on the rest of the
+    // module and would make every change elsewhere miss the cache
+    static void printWithoutSlots(raw_ostream &OS, StringRef text)
+    {
+      for (size_t i = 0; i < text.size(); i++)
+      {
+        OS << text[i];
+        if (text[i] == '!' || text[i] == '#')
+          while (i + 1 < text.size() && isDigit(text[i + 1]))
+            i++;
+      }
     }
 
-    bool loopPeel(
-        LoopInfo &LI,
-        Loop *loop,
-        DominatorTree &DT,
-        ScalarEvolution &SE,
-        AssumptionCache &AC)
+    SmallString<128> entryPath(StringRef key)
+    {
+      SmallString<128> path(CacheDir);
+      sys::path::append(path, key);
+      return path;
+    }
+
+    const ModuleSummaries &summaries;
+    bool enabled = false, warned = false;
+    std::string moduleKey;
+    DenseMap<Function *, SmallString<32>> keys;
+  };
+
+  struct CAT : public ModulePass
+  {
+    static char ID;
+
+    CAT() : ModulePass(ID) {}
+    ModuleSummaries summaries;
+    // the code the loop transformations may still add to the module
+    uint64_t loopBudget;
+    // whether a loop of the function transformed last was planned, whose result then depends on the unrolling preferences of
+    // LLVM and on the functions transformed before it, so the analysis cache can't record it
+    bool plannedLoops;
+    // the profile of the module, or null if it has none
+    ProfileSummaryInfo *PSI;
+    // the block frequencies of the last function getBFI was called on
+    BranchProbabilityInfo BPI;
+    BlockFrequencyInfo BFI;
+
+    Module *curModule;
+
+    // This function is invoked once at the initialization phase of the compiler
+    // The LLVM IR of functions isn't ready at this point
+    bool doInitialization(Module &M) override
     {
-      if (loop->isLoopSimplifyForm() && loop->isLCSSAForm(DT))
-        if (peelLoop(loop, 2, &LI, &SE, DT, &AC, true))
-          return true;
+      curModule = &M;
       return false;
     }
 
@@ -1175,45 +4035,172 @@ namespace
     // The LLVM IR of the input functions is ready and it can be analyzed and/or transformed
     bool runOnFunction(Function &F)
     {
-      bool changed = false;
-      resetGlobalMaps();
-      curFunc = &F;
+      FunctionContext ctx(F, summaries.funcSummaries, summaries.moduleInfo);
+      prepareFunction(ctx);
+      {
+        auto timer = timePhase(&PhaseTimers::rda);
+        ctx.RDA();
+      }
+      return transformFunction(ctx);
+    }
+
+    // the part of the analysis that needs alias analysis, which the pass manager provides for one function at a time
+    void prepareFunction(FunctionContext &ctx)
+    {
+      ctx.AA = &getAnalysis<AAResultsWrapperPass>(*ctx.curFunc).getAAResults();
+      ctx.collectTypeInfo();
+      ctx.summarizeCallSites();
+    }
 
-      AA = &getAnalysis<AAResultsWrapperPass>(F).getAAResults();
-      collectTypeInfo();
-      RDA();
-      // dumpTypeInfo();
-      // dumpRDAInfo();
+    bool foldFunction(FunctionContext &ctx)
+    {
+      ctx.AA = &getAnalysis<AAResultsWrapperPass>(*ctx.curFunc).getAAResults();
 
-      changed |= constantFoldAndAlgSimp();
-      changed |= constantProp();
+      bool changed = ctx.constantFoldAndProp();
+      changed |= ctx.eliminateRedundantCalls();
+      changed |= ctx.eliminateDeadCode();
+      changed |= ctx.hoistLoopInvariants();
+      cout << ctx.log.str();
+      ctx.messages.clear();
+      return changed;
+    }
 
-      if (!changed)
-        changed |= transformLoops();
+    // fold the function, then transform its loops, analyze it again and fold the new code, until the loops are done
+    bool transformFunction(FunctionContext &ctx)
+    {
+      auto &F = *ctx.curFunc;
+      bool changed = foldFunction(ctx);
+      plannedLoops = false;
+
+      for (unsigned round = 0; round < LoopRounds; round++)
+      {
+        // each request runs the analyses of F again, which recomputes the loops and the dominator tree in place but replaces
+        // the scalar evolution, so it is requested last
+        auto &LI = getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+        auto &DT = getAnalysis<DominatorTreeWrapperPass>(F).getDomTree();
+        auto *frequencies = PSI ? &getBFI(F) : nullptr;
+        auto &SE = getAnalysis<ScalarEvolutionWrapperPass>(F).getSE();
+        bool transformed = LoopTransforms::transformLoops(F, loopBudget, plannedLoops, *ctx.moduleInfo, LI, DT, SE,
+                                                          getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F),
+                                                          getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F), PSI, frequencies);
+        if (!transformed)
+          break;
+        changed = true;
+
+        FunctionContext next(F, summaries.funcSummaries, summaries.moduleInfo);
+        prepareFunction(next);
+        {
+          auto timer = timePhase(&PhaseTimers::rda);
+          next.RDA();
+        }
+        foldFunction(next);
+      }
 
+      // the objects left once the loops are done are kept in registers, and the CAT_get and CAT_set of heap objects the lowering
+      // adds are folded with a new analysis, which may hoist them out of the loops
+      bool heapCalls = false;
+      if (ScalarReplacement && promoteLocalObjects(F, *ctx.moduleInfo, getAnalysis<DominatorTreeWrapperPass>(F).getDomTree(),
+                                                   getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F), heapCalls))
+      {
+        changed = true;
+        if (heapCalls)
+        {
+          FunctionContext next(F, summaries.funcSummaries, summaries.moduleInfo);
+          prepareFunction(next);
+          {
+            auto timer = timePhase(&PhaseTimers::rda);
+            next.RDA();
+          }
+          foldFunction(next);
+        }
+      }
       return changed;
     }
 
-    bool runOnModule(Module &M) override
+    // the block frequencies of F, from the branch weights of the profile
+    // the pass manager can't keep them on the fly next to scalar evolution, so they are computed here, and are valid until
+    // the next call
+    BlockFrequencyInfo &getBFI(Function &F)
+    {
+      auto &LI = getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+      BPI.calculate(F, LI, &getAnalysis<TargetLibraryInfoWrapperPass>().getTLI(F), nullptr, nullptr);
+      BFI.calculate(F, BPI, LI);
+      return BFI;
+    }
+
+    // analyze the functions in batches
+    // alias analysis and the IR mutations stay on the thread of the pass, the RDA of a batch runs on the pool
+    bool runOnFunctionsInParallel(std::vector<Function *> &functions, unsigned threads, AnalysisCache &cache)
     {
       bool modified = false;
+      ThreadPool pool(hardware_concurrency(threads));
 
-      for (auto &F : M)
-        if (!F.isDeclaration())
+      for (size_t begin = 0; begin < functions.size(); begin += threads)
+      {
+        std::vector<std::unique_ptr<FunctionContext>> contexts;
+        for (size_t i = begin; i < std::min(functions.size(), begin + threads); i++)
         {
-          if (F.hasFnAttribute(llvm::Attribute::NoInline))
-            F.removeFnAttr(llvm::Attribute::NoInline);
-          F.addFnAttr(llvm::Attribute::AlwaysInline);
-          modified = true;
+          contexts.push_back(std::make_unique<FunctionContext>(*functions[i], summaries.funcSummaries, summaries.moduleInfo));
+          prepareFunction(*contexts.back());
+          contexts.back()->precomputeCallQueries();
+          contexts.back()->AA = nullptr;
         }
 
-      for (auto &F : M)
+        // the batch is timed as a whole, timers can't run on the pool
+        {
+          auto timer = timePhase(&PhaseTimers::rda);
+          for (auto &ctx : contexts)
+          {
+            auto *analyzed = ctx.get();
+            pool.async([analyzed]
+                       { analyzed->RDA(); });
+          }
+          pool.wait();
+        }
+
+        for (auto &ctx : contexts)
+        {
+          bool changed = transformFunction(*ctx);
+          if (!changed && !plannedLoops)
+            cache.recordUnchanged(*ctx->curFunc);
+          modified |= changed;
+        }
+      }
+
+      return modified;
+    }
+
+    bool runOnModule(Module &M) override
+    {
+      bool modified = false;
+      requestStatsJSON();
+      loopBudget = LoopGrowthBudget;
+      PSI = usedProfile(getAnalysis<ProfileSummaryInfoWrapperPass>().getPSI());
+
+      auto &CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+      summaries.summarizeFunctions(CG);
+      CallSiteSet hot;
+      if (PSI)
+        hot = hotCallSites(M, *PSI, [this](Function &F) -> BlockFrequencyInfo &
+                           { return getBFI(F); });
+      modified |= markInlining(M, CG, summaries, PSI ? &hot : nullptr);
+      AnalysisCache cache(M, summaries, PSI);
+      auto functions = functionsToOptimize(M);
+      llvm::erase_if(functions, [&cache](Function *F)
+                     { return cache.isUnchanged(*F); });
+      // counted once per function, however many times the loop rounds analyze it again
+      NumFunctions += functions.size();
+
+      unsigned threads = hardware_concurrency(AnalysisThreads).compute_thread_count();
+      if (threads > 1 && functions.size() > 1)
+        return runOnFunctionsInParallel(functions, threads, cache) || modified;
+
+      for (auto *F : functions)
       {
-        if (F.isDeclaration())
-          continue;
-        else if ((F.getNumUses() == 0) && (&F != curModule->getFunction("main")))
-          continue;
-        modified |= runOnFunction(F);
+        bool changed = runOnFunction(*F);
+        if (!changed && !plannedLoops)
+          cache.recordUnchanged(*F);
+        modified |= changed;
       }
 
       return modified;
@@ -1222,6 +4209,8 @@ namespace
     void getAnalysisUsage(AnalysisUsage &AU) const override
     {
       AU.addRequired<CallGraphWrapperPass>();
+      AU.addRequired<ProfileSummaryInfoWrapperPass>();
+      AU.addRequired<TargetLibraryInfoWrapperPass>();
       AU.addRequired<AAResultsWrapperPass>();
       AU.addRequired<AssumptionCacheTracker>();
       AU.addRequired<DominatorTreeWrapperPass>();
@@ -1231,6 +4220,201 @@ namespace
       // nothing is preserved, so we don't need to do anything here
     }
   };
+
+  // the CAT type info of a function, for the new pass manager
+  struct CATTypeInfoAnalysis : public AnalysisInfoMixin<CATTypeInfoAnalysis>
+  {
+    struct Result
+    {
+      DenseMap<Value *, VType> catTypes;
+      std::shared_ptr<const ModuleInfo> moduleInfo;
+    };
+
+    Result run(Function &F, FunctionAnalysisManager &FAM);
+
+    static AnalysisKey Key;
+  };
+  AnalysisKey CATTypeInfoAnalysis::Key;
+
+  // the function summaries of a module, for the new pass manager
+  // the RDA results copy what they need from the summaries, so the function analyses can read them as an immutable
+  // outer result, and the CAT pass refreshes them at each run
+  struct CATSummaryAnalysis : public AnalysisInfoMixin<CATSummaryAnalysis>
+  {
+    struct Result : public ModuleSummaries
+    {
+      bool invalidate(Module &, const PreservedAnalyses &, ModuleAnalysisManager::Invalidator &) { return false; }
+    };
+
+    Result run(Module &M, ModuleAnalysisManager &MAM)
+    {
+      Result summaries;
+      summaries.summarizeFunctions(MAM.getResult<CallGraphAnalysis>(M));
+      return summaries;
+    }
+
+    static AnalysisKey Key;
+  };
+  AnalysisKey CATSummaryAnalysis::Key;
+
+  // the globals are classified with the summaries of the module, unless the CAT pass didn't compute them
+  CATTypeInfoAnalysis::Result CATTypeInfoAnalysis::run(Function &F, FunctionAnalysisManager &FAM)
+  {
+    static const FunctionSummaryMap none;
+    auto &MAMProxy = FAM.getResult<ModuleAnalysisManagerFunctionProxy>(F);
+    auto *summaries = MAMProxy.getCachedResult<CATSummaryAnalysis>(*F.getParent());
+    FunctionContext ctx(F, none, summaries ? summaries->moduleInfo : std::make_shared<ModuleInfo>(*F.getParent()));
+    ctx.collectTypeInfo();
+    return {std::move(ctx.catTypes), std::move(ctx.moduleInfo)};
+  }
+
+  // the RDA of a function, for the new pass manager
+  // it holds the whole context of the function, which is valid as long as the IR, the type info and alias analysis are
+  struct CATRDAAnalysis : public AnalysisInfoMixin<CATRDAAnalysis>
+  {
+    struct Result
+    {
+      std::unique_ptr<FunctionContext> ctx;
+
+      bool invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &Inv)
+      {
+        auto PAC = PA.getChecker<CATRDAAnalysis>();
+        return !(PAC.preserved() || PAC.preservedSet<AllAnalysesOn<Function>>()) ||
+               Inv.invalidate<CATTypeInfoAnalysis>(F, PA) || Inv.invalidate<AAManager>(F, PA);
+      }
+    };
+
+    Result run(Function &F, FunctionAnalysisManager &FAM)
+    {
+      static const FunctionSummaryMap none;
+      auto &types = FAM.getResult<CATTypeInfoAnalysis>(F);
+      auto &MAMProxy = FAM.getResult<ModuleAnalysisManagerFunctionProxy>(F);
+      auto *summaries = MAMProxy.getCachedResult<CATSummaryAnalysis>(*F.getParent());
+
+      Result result{std::make_unique<FunctionContext>(F, summaries ? summaries->funcSummaries : none, types.moduleInfo)};
+      auto &ctx = *result.ctx;
+      ctx.catTypes = types.catTypes;
+      ctx.AA = &FAM.getResult<AAManager>(F);
+      ctx.summarizeCallSites();
+      ctx.funcSummaries = nullptr;
+      auto timer = timePhase(&PhaseTimers::rda);
+      ctx.RDA();
+      return result;
+    }
+
+    static AnalysisKey Key;
+  };
+  AnalysisKey CATRDAAnalysis::Key;
+
+  // the CAT pass for the new pass manager
+  struct CATPass : public PassInfoMixin<CATPass>
+  {
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM)
+    {
+      requestStatsJSON();
+      auto &CG = MAM.getResult<CallGraphAnalysis>(M);
+      auto *summaries = MAM.getCachedResult<CATSummaryAnalysis>(M);
+      if (summaries)
+        summaries->summarizeFunctions(CG);
+      else
+        summaries = &MAM.getResult<CATSummaryAnalysis>(M);
+      auto &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+      auto *PSI = usedProfile(MAM.getResult<ProfileSummaryAnalysis>(M));
+      CallSiteSet hot;
+      if (PSI)
+        hot = hotCallSites(M, *PSI, [&FAM](Function &F) -> BlockFrequencyInfo &
+                           { return FAM.getResult<BlockFrequencyAnalysis>(F); });
+      bool modified = markInlining(M, CG, *summaries, PSI ? &hot : nullptr);
+      SmallPtrSet<Function *, 8> changedFunctions;
+      uint64_t loopBudget = LoopGrowthBudget;
+      AnalysisCache cache(M, *summaries, PSI);
+
+      for (auto *F : functionsToOptimize(M))
+      {
+        if (cache.isUnchanged(*F))
+          continue;
+        NumFunctions++;
+        // the plans of the loops depend on the unrolling preferences of LLVM and on the functions transformed before
+        bool plannedLoops = false;
+
+        // fold the function, then transform its loops and fold it again with fresh analyses, until the loops are done
+        for (unsigned round = 0;; round++)
+        {
+          auto &ctx = *FAM.getResult<CATRDAAnalysis>(*F).ctx;
+          ctx.AA = &FAM.getResult<AAManager>(*F);
+          bool folded = ctx.constantFoldAndProp();
+          folded |= ctx.eliminateRedundantCalls();
+          folded |= ctx.eliminateDeadCode();
+          folded |= ctx.hoistLoopInvariants();
+          cout << ctx.log.str();
+          ctx.messages.clear();
+
+          bool transformed = round < LoopRounds &&
+                             LoopTransforms::transformLoops(*F, loopBudget, plannedLoops, *ctx.moduleInfo, FAM.getResult<LoopAnalysis>(*F),
+                                                            FAM.getResult<DominatorTreeAnalysis>(*F),
+                                                            FAM.getResult<ScalarEvolutionAnalysis>(*F),
+                                                            FAM.getResult<AssumptionAnalysis>(*F), FAM.getResult<TargetIRAnalysis>(*F), PSI,
+                                                            PSI ? &FAM.getResult<BlockFrequencyAnalysis>(*F) : nullptr);
+          if (!folded && !transformed)
+            break;
+
+          // folding rewrites calls only, loop transformations change the CFG
+          PreservedAnalyses PA = PreservedAnalyses::none();
+          if (!transformed)
+            PA.preserveSet<CFGAnalyses>();
+          FAM.invalidate(*F, PA);
+          changedFunctions.insert(F);
+          modified = true;
+          if (!transformed)
+            break;
+        }
+
+        // the objects left once the loops are done are kept in registers, which leaves the CFG alone, and the CAT_get and CAT_set
+        // of heap objects the lowering adds are folded with a new analysis
+        bool heapCalls = false;
+        if (ScalarReplacement && promoteLocalObjects(*F, *summaries->moduleInfo, FAM.getResult<DominatorTreeAnalysis>(*F),
+                                                     FAM.getResult<AssumptionAnalysis>(*F), heapCalls))
+        {
+          PreservedAnalyses PA = PreservedAnalyses::none();
+          PA.preserveSet<CFGAnalyses>();
+          FAM.invalidate(*F, PA);
+          changedFunctions.insert(F);
+          modified = true;
+          if (heapCalls)
+          {
+            auto &ctx = *FAM.getResult<CATRDAAnalysis>(*F).ctx;
+            ctx.AA = &FAM.getResult<AAManager>(*F);
+            bool folded = ctx.constantFoldAndProp();
+            folded |= ctx.eliminateRedundantCalls();
+            folded |= ctx.eliminateDeadCode();
+            folded |= ctx.hoistLoopInvariants();
+            cout << ctx.log.str();
+            ctx.messages.clear();
+            if (folded)
+              FAM.invalidate(*F, PA);
+          }
+        }
+        if (!changedFunctions.count(F) && !plannedLoops)
+          cache.recordUnchanged(*F);
+      }
+
+      // the call sites in the callers of a changed function were summarized with its old summary
+      PreservedAnalyses stale = PreservedAnalyses::all();
+      stale.abandon<CATRDAAnalysis>();
+      for (auto *F : changedFunctions)
+        for (auto *U : F->users())
+          if (auto *callInst = dyn_cast<CallInst>(U))
+            FAM.invalidate(*callInst->getFunction(), stale);
+
+      if (!modified)
+        return PreservedAnalyses::all();
+      // the functions changed are already invalidated, the results of the others are still valid
+      PreservedAnalyses PA = PreservedAnalyses::none();
+      PA.preserve<FunctionAnalysisManagerModuleProxy>();
+      PA.preserveSet<AllAnalysesOn<Function>>();
+      return PA;
+    }
+  };
 }
 
 // Next there is code to register your pass to "opt"
@@ -1247,3 +4431,31 @@ static RegisterStandardPasses _RegPass2(PassManagerBuilder::EP_EnabledOnOptLevel
                                         [](const PassManagerBuilder &, legacy::PassManagerBase &PM)
                                         {
         if(!_PassMaker){ PM.add(_PassMaker = new CAT()); } }); // ** for -O0
+// the merged module of a full LTO link holds the functions and the globals of every translation unit
+static RegisterStandardPasses _RegPass3(PassManagerBuilder::EP_FullLinkTimeOptimizationLast,
+                                        [](const PassManagerBuilder &, legacy::PassManagerBase &PM)
+                                        { PM.add(new CAT()); }); // ** for -flto
+
+// Next there is code to register your pass to the new pass manager of "opt" and "clang"
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo()
+{
+  return {LLVM_PLUGIN_API_VERSION, "CAT", LLVM_VERSION_STRING, [](PassBuilder &PB)
+          {
+            PB.registerAnalysisRegistrationCallback([](FunctionAnalysisManager &FAM)
+                                                    {
+                                                      FAM.registerPass([]
+                                                                       { return CATTypeInfoAnalysis(); });
+                                                      FAM.registerPass([]
+                                                                       { return CATRDAAnalysis(); }); });
+            PB.registerAnalysisRegistrationCallback([](ModuleAnalysisManager &MAM)
+                                                    { MAM.registerPass([]
+                                                                       { return CATSummaryAnalysis(); }); });
+            PB.registerPipelineParsingCallback([](StringRef name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>)
+                                               {
+                                                 if (!name.equals("CAT"))
+                                                   return false;
+                                                 MPM.addPass(CATPass());
+                                                 return true; });
+            PB.registerOptimizerLastEPCallback([](ModulePassManager &MPM, OptimizationLevel)
+                                               { MPM.addPass(CATPass()); }); }};
+}
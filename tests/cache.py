@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Checks that the analysis cache never changes the output of the pass: in each case, a module of tests/cache is optimized
+# without a cache, then again after other compilations filled a cache, and the IR and the diagnostics must be the same.
+# In cache/a.ll the loop budget runs out before @b is transformed, so @b is left unchanged; in cache/b.ll it is peeled.
+# Without unrolling and peeling thresholds, LLVM's preferences leave the loop of cache/b.ll alone.
+# cache/c.ll is left unchanged, but its diagnostics report a blocked fold.
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+A = os.path.join(HERE, "cache", "a.ll")
+B = os.path.join(HERE, "cache", "b.ll")
+C = os.path.join(HERE, "cache", "c.ll")
+OPTIONS = ["-cat-loop-budget=20", "-cat-loop-rounds=1", "-cat-inline=selective"]
+NO_UNROLLING = ["-unroll-threshold=0", "-unroll-partial-threshold=0"]
+DIAGNOSTICS = ["-cat-diagnostics=-"]
+
+# name, the compilations filling the cache, and the compilation checked, as (module, options)
+CASES = [
+  ("loop budget", [(A, OPTIONS)], (B, OPTIONS)),
+  ("loop budget", [(B, OPTIONS)], (A, OPTIONS)),
+  ("unrolling preferences", [(B, OPTIONS + NO_UNROLLING)], (B, OPTIONS)),
+  ("diagnostics", [(C, OPTIONS)], (C, OPTIONS + DIAGNOSTICS)),
+]
+
+
+def fail(message):
+  sys.exit("cache.py: " + message)
+
+
+def optimize(args, module, options):
+  load = ["-load", args.pass_path]
+  if args.new_pm:
+    command = [args.opt] + load + ["-load-pass-plugin=" + args.pass_path, "-passes=CAT"]
+  else:
+    command = [args.opt, "-enable-new-pm=0"] + load + ["-CAT"]
+  result = subprocess.run(command + options + [module, "-S", "-o", "-"], stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE)
+  if result.returncode != 0:
+    sys.stderr.write(result.stderr.decode(errors="replace"))
+    fail("opt exited with %d on %s" % (result.returncode, module))
+  return result.stdout, result.stderr
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Test that the analysis cache of the CAT pass doesn't change its output.")
+  parser.add_argument("--pass", dest="pass_path", required=True, help="the CAT pass library (CAT.so)")
+  parser.add_argument("--opt", default="opt", help="the opt to run the pass with")
+  parser.add_argument("--new-pm", action="store_true", help="run the pass with the new pass manager")
+  args = parser.parse_args()
+
+  failed = False
+  for name, earlier, (module, options) in CASES:
+    expected = optimize(args, module, options)
+    cache = tempfile.mkdtemp(prefix="cat-cache-")
+    try:
+      for other, otherOptions in earlier:
+        optimize(args, other, otherOptions + ["-cat-cache-dir=" + cache])
+      if optimize(args, module, options + ["-cat-cache-dir=" + cache]) != expected:
+        print("%s (%s): the output or the diagnostics differ after the earlier compilations with the same cache" % (os.path.basename(module), name))
+        failed = True
+    finally:
+      shutil.rmtree(cache)
+  if failed:
+    sys.exit(1)
+  print("the analysis cache doesn't change the output")
+
+
+if __name__ == "__main__":
+  main()
@@ -0,0 +1,65 @@
+; Module A of the analysis cache test: @a and @b peel the same loop, and @a spends the loop budget before @b gets to it.
+declare i8* @CAT_new(i64)
+declare void @CAT_add(i8*, i8*, i8*)
+declare void @CAT_set(i8*, i64)
+declare i64 @CAT_get(i8*)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i64 @a(i64 %n) {
+entry:
+  %x = call i8* @CAT_new(i64 1)
+  %one = call i8* @CAT_new(i64 1)
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ]
+  %v = call i64 @CAT_get(i8* %x)
+  call void @CAT_add(i8* %x, i8* %x, i8* %one)
+  %next = add i64 %i, %v
+  %again = icmp slt i64 %next, %n
+  br i1 %again, label %loop, label %exit
+
+exit:
+  %r = call i64 @CAT_get(i8* %x)
+  call void @sink(i8* %x, i8* %one)
+  ret i64 %r
+}
+
+define i64 @b(i64 %n) {
+entry:
+  %x = call i8* @CAT_new(i64 1)
+  %one = call i8* @CAT_new(i64 1)
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ]
+  %v = call i64 @CAT_get(i8* %x)
+  call void @CAT_add(i8* %x, i8* %x, i8* %one)
+  %next = add i64 %i, %v
+  %again = icmp slt i64 %next, %n
+  br i1 %again, label %loop, label %exit
+
+exit:
+  %r = call i64 @CAT_get(i8* %x)
+  call void @sink(i8* %x, i8* %one)
+  ret i64 %r
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %n32 = mul i32 %argc, 100
+  %n = sext i32 %n32 to i64
+  %ra = call i64 @a(i64 %n)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %ra)
+  %rb = call i64 @b(i64 %n)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %rb)
+  ret i32 0
+}
+
+define void @sink(i8* %x, i8* %y) {
+entry:
+  ret void
+}
@@ -0,0 +1,21 @@
+; Module C of the analysis cache test: nothing to fold, but the diagnostics report the CAT_get of @peek as blocked.
+declare i8* @CAT_new(i64)
+declare i64 @CAT_get(i8*)
+declare i32 @printf(i8*, ...)
+
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+
+define i64 @peek(i8* %d) {
+entry:
+  %v = call i64 @CAT_get(i8* %d)
+  ret i64 %v
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  %fmt = getelementptr [5 x i8], [5 x i8]* @fmt, i64 0, i64 0
+  %d = call i8* @CAT_new(i64 3)
+  %v = call i64 @peek(i8* %d)
+  call i32 (i8*, ...) @printf(i8* %fmt, i64 %v)
+  ret i32 0
+}